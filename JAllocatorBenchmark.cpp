@@ -0,0 +1,145 @@
+#include "JAllocatorBenchmark.h"
+
+#include "JMemoryAllocator.h"
+#include "vkutils.h"
+
+#include <stdexcept>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+
+JAllocatorBenchmark::JAllocatorBenchmark(const JDevice* device, std::ostream& out, uint32_t opCount, uint32_t liveCount, uint32_t seed)
+	: _pDevice(device)
+	, _out(out)
+	, _slots(liveCount)
+{
+	_memoryType = findMemoryType(_pDevice->allocator()->memoryProperties(), ~0u, MemoryUsage::GpuOnly,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> logSize(std::log2(256.0), std::log2(1024.0 * 1024.0));
+	std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+	// slots that are free and slots that are alive, picked from at random
+	std::vector<uint32_t> freeSlots;
+	std::vector<uint32_t> liveSlots;
+	for (uint32_t i = 0; i < liveCount; ++i) {
+		freeSlots.push_back(liveCount - 1 - i);
+	}
+	auto take = [&random](std::vector<uint32_t>& slots) {
+		size_t i = std::uniform_int_distribution<size_t>(0, slots.size() - 1)(random);
+		uint32_t slot = slots[i];
+		slots[i] = slots.back();
+		slots.pop_back();
+		return slot;
+	};
+
+	// mostly allocations until it's full, then it churns
+	for (uint32_t i = 0; i < opCount; ++i) {
+		bool allocate = !freeSlots.empty() && (liveSlots.empty() || coin(random) < 0.6);
+		if (allocate) {
+			uint32_t slot = take(freeSlots);
+			liveSlots.push_back(slot);
+			_ops.push_back({ true, slot, static_cast<VkDeviceSize>(std::exp2(logSize(random))) });
+		}
+		else {
+			uint32_t slot = take(liveSlots);
+			freeSlots.push_back(slot);
+			_ops.push_back({ false, slot, 0 });
+		}
+	}
+	// and everything's freed at the end
+	for (uint32_t slot : liveSlots) {
+		_ops.push_back({ false, slot, 0 });
+	}
+}
+
+double JAllocatorBenchmark::runAllocator()
+{
+	JMemoryAllocator allocator(_pDevice);
+	std::vector<JAllocation> allocations(_slots);
+	VkMemoryRequirements requirements{};
+	requirements.alignment = 256;
+	requirements.memoryTypeBits = 1u << _memoryType;
+
+	// the sequence ends by freeing everything, stats are taken after the last allocation before that
+	size_t churnEnd = _ops.size();
+	while (churnEnd > 0 && !_ops[churnEnd - 1].allocate) {
+		--churnEnd;
+	}
+
+	JMemoryTypeStats churned;
+	auto start = std::chrono::steady_clock::now();
+	double seconds = 0.0;
+	for (size_t i = 0; i < _ops.size(); ++i) {
+		if (i == churnEnd) {
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			churned = allocator.stats().types[_memoryType];
+			start = std::chrono::steady_clock::now();
+		}
+		const Op& op = _ops[i];
+		if (op.allocate) {
+			requirements.size = op.size;
+			allocations[op.slot] = allocator.allocate(requirements, _memoryType, JAllocationKind::JLinear);
+		}
+		else {
+			allocator.free(allocations[op.slot]);
+		}
+	}
+	seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// one empty block should be kept, and the next allocation should go in it instead of a new one
+	uint32_t keptBlocks = allocator.stats().types[_memoryType].blockCount;
+	requirements.size = 256;
+	JAllocation again = allocator.allocate(requirements, _memoryType, JAllocationKind::JLinear);
+	bool reused = keptBlocks > 0 && allocator.stats().types[_memoryType].blockCount == keptBlocks;
+	allocator.free(again);
+
+	const double mb = 1024.0 * 1024.0;
+	_out << "  JMemoryAllocator: " << seconds * 1000.0 << " ms (" << seconds * 1e6 / _ops.size() << " us per op)" << std::endl;
+	_out << "    after the churn: " << churned.allocationCount << " allocations in " << churned.blockCount << " blocks, "
+		<< churned.allocatedBytes / mb << " MB taken from the driver for " << churned.usedBytes / mb << " MB used, "
+		<< "largest free range " << churned.largestFreeRange / mb << " MB, fragmentation " << churned.fragmentation << std::endl;
+	_out << "    after freeing everything: " << keptBlocks << " block(s) kept, the next allocation "
+		<< (reused ? "reused it" : "took a new block") << std::endl;
+	return seconds;
+}
+
+double JAllocatorBenchmark::runDriver()
+{
+	VkDevice device = _pDevice->device();
+	std::vector<VkDeviceMemory> memory(_slots, VK_NULL_HANDLE);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.memoryTypeIndex = _memoryType;
+
+	auto start = std::chrono::steady_clock::now();
+	for (const Op& op : _ops) {
+		if (op.allocate) {
+			allocInfo.allocationSize = op.size;
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &memory[op.slot]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate device memory!");
+			}
+		}
+		else {
+			vkFreeMemory(device, memory[op.slot], nullptr);
+			memory[op.slot] = VK_NULL_HANDLE;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	_out << "  vkAllocateMemory: " << seconds * 1000.0 << " ms (" << seconds * 1e6 / _ops.size() << " us per op)" << std::endl;
+	return seconds;
+}
+
+void JAllocatorBenchmark::run()
+{
+	_out << "allocator benchmark: " << _ops.size() << " allocations and frees, up to " << _slots
+		<< " alive at once, memory type " << _memoryType << std::endl;
+	double allocatorSeconds = runAllocator();
+	double driverSeconds = runDriver();
+	if (allocatorSeconds > 0.0) {
+		_out << "  JMemoryAllocator was " << driverSeconds / allocatorSeconds << "x as fast" << std::endl;
+	}
+}
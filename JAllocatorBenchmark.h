@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <ostream>
+#include <vector>
+#include <cstdint>
+
+#include "JDevice.h"
+
+// times JMemoryAllocator against calling vkAllocateMemory for every resource, with the same random
+// sequence of allocations and frees, and reports how fragmented the blocks get and whether an emptied
+// block is reused instead of going back to the driver
+// uses its own allocator, so the device's stats aren't touched, run with --mode=bench_allocator
+class JAllocatorBenchmark
+{
+protected:
+	// one step of the sequence, either allocate size bytes into slot, or free whatever's in slot
+	struct Op {
+		bool allocate;
+		uint32_t slot;
+		VkDeviceSize size;
+	};
+
+	const JDevice* _pDevice;
+	std::ostream& _out;
+	uint32_t _memoryType;
+	std::vector<Op> _ops;
+	uint32_t _slots;
+
+	double runAllocator();
+	double runDriver();
+
+public:
+	JAllocatorBenchmark() = delete;
+	JAllocatorBenchmark(const JAllocatorBenchmark&) = delete;
+	void operator=(const JAllocatorBenchmark&) = delete;
+
+	// opCount allocations and frees with at most liveCount allocations alive at once, sizes between
+	// 256 bytes and 1MB (spread evenly in log scale, like real buffers are), always the same for a seed
+	// liveCount has to stay under maxMemoryAllocationCount (at least 4096) for the driver run
+	JAllocatorBenchmark(const JDevice* device, std::ostream& out, uint32_t opCount = 100000, uint32_t liveCount = 1024, uint32_t seed = 1);
+
+	// prints the results
+	void run();
+};
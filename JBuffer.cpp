@@ -1,6 +1,7 @@
 #include "JBuffer.h"
 #include "vkutils.h"
 #include <stdexcept>
+#include <cstring>
 
 
 
@@ -34,21 +35,77 @@ JBuffer::JBuffer(
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(_pDevice->device(), _buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(_pDevice->physical(), memRequirements.memoryTypeBits,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// properties are what we need, the policy also decides what we'd like (e.g. device local
+	// host visible memory for uniforms when there's resizable BAR)
+	uint32_t memoryType = findMemoryType(_pDevice->allocator()->memoryProperties(), memRequirements.memoryTypeBits,
+		memoryUsageFor(_properties, _usage), _properties);
 
-	if (vkAllocateMemory(_pDevice->device(), &allocInfo, nullptr, &_bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
+	// sub-allocate from one of the allocator's blocks rather than allocating memory just for us
+	_allocation = _pDevice->allocator()->allocate(memRequirements, memoryType, JAllocationKind::JLinear);
+
+	vkBindBufferMemory(_pDevice->device(), _buffer, _allocation.memory, _allocation.offset);
+}
+
+JBuffer::JBuffer(JBuffer&& other) noexcept
+	: _buffer(other._buffer)
+	, _allocation(other._allocation)
+	, _pDevice(other._pDevice)
+	, _size(other._size)
+	, _usage(other._usage)
+	, _properties(other._properties)
+{
+	other._buffer = VK_NULL_HANDLE;
+	other._allocation = JAllocation{};
+}
 
-	vkBindBufferMemory(_pDevice->device(), _buffer, _bufferMemory, 0);
+JBuffer& JBuffer::operator=(JBuffer&& other) noexcept
+{
+	if (this != &other) {
+		destroy();
+		_buffer = other._buffer;
+		_allocation = other._allocation;
+		_pDevice = other._pDevice;
+		_size = other._size;
+		_usage = other._usage;
+		_properties = other._properties;
+		other._buffer = VK_NULL_HANDLE;
+		other._allocation = JAllocation{};
+	}
+	return *this;
 }
 
 JBuffer::~JBuffer()
 {
-	vkDestroyBuffer(_pDevice->device(), _buffer, nullptr);
-	vkFreeMemory(_pDevice->device(), _bufferMemory, nullptr);
+	destroy();
+}
+
+void JBuffer::destroy()
+{
+	if (_buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(_pDevice->device(), _buffer, nullptr);
+		_buffer = VK_NULL_HANDLE;
+	}
+	_pDevice->allocator()->free(_allocation); // no-op for an empty allocation
+}
+
+void JBuffer::write(const void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+	if (_allocation.mapped == nullptr) {
+		throw std::runtime_error("writing to a buffer that is not host visible!");
+	}
+	if (offset + size > _size) {
+		throw std::runtime_error("write out of range for buffer!");
+	}
+	memcpy(static_cast<char*>(_allocation.mapped) + offset, data, static_cast<size_t>(size));
+	flush(offset, size);
+}
+
+void JBuffer::flush(VkDeviceSize offset, VkDeviceSize size)
+{
+	_pDevice->allocator()->flush(_allocation, offset, size);
+}
+
+void JBuffer::invalidate(VkDeviceSize offset, VkDeviceSize size)
+{
+	_pDevice->allocator()->invalidate(_allocation, offset, size);
 }
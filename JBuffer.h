@@ -1,16 +1,20 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
 #include "JDevice.h"
+#include "JMemoryAllocator.h"
 
 
 
+// owns a VkBuffer and its memory
+// movable, so buffers can be stored by value (the moved-from buffer is left empty)
 class JBuffer
 {
 protected:
-	VkBuffer _buffer;
-	VkDeviceMemory _bufferMemory;
+	VkBuffer _buffer = VK_NULL_HANDLE;
+	JAllocation _allocation;
 	//VkDevice _device;
 	//VkPhysicalDevice _physDevice;
 	const JDevice* _pDevice;
@@ -21,8 +25,10 @@ protected:
 public:
 
 	inline VkBuffer buffer() const { return _buffer; }
-	inline VkDeviceMemory memory() const { return _bufferMemory; }
-	
+	inline VkDeviceMemory memory() const { return _allocation.memory; }
+	inline VkDeviceSize offset() const { return _allocation.offset; } // offset of the buffer in memory()
+	inline VkDeviceSize size() const { return _size; }
+
 	JBuffer(
 		//VkPhysicalDevice physicalDevice,
 		//VkDevice device,
@@ -31,10 +37,37 @@ public:
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties);
 
+	// host visible buffers are persistently mapped, this is where the buffer starts in host memory
+	// (nullptr if the buffer isn't host visible)
+	// memory() may be shared with other resources, so never vkMapMemory it directly
+	inline void* mapped() const { return _allocation.mapped; }
+	inline bool isCoherent() const { return _pDevice->allocator()->isCoherent(_allocation.memoryType); }
+
+	// copies data into the mapped buffer at offset and flushes it if the memory isn't coherent
+	void write(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+	template<typename T>
+	inline void write(const T& value, VkDeviceSize offset = 0) { write(&value, sizeof(T), offset); }
+	template<typename T>
+	inline void write(const std::vector<T>& values, VkDeviceSize offset = 0) { write(values.data(), sizeof(T) * values.size(), offset); }
+
+	// for writing through mapped() directly, make the writes visible to the GPU
+	// (or GPU writes visible to the CPU for invalidate), no-ops on coherent memory
+	void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
 	JBuffer() = delete;
 	JBuffer(const JBuffer&) = delete;
 	void operator=(const JBuffer&) = delete;
 
+	JBuffer(JBuffer&& other) noexcept;
+	JBuffer& operator=(JBuffer&& other) noexcept;
+
 	virtual ~JBuffer();
+
+	// false once the buffer has been moved from
+	inline bool valid() const { return _buffer != VK_NULL_HANDLE; }
+
+private:
+	void destroy();
 };
 
@@ -5,30 +5,42 @@ JCommandBuffers::JCommandBuffers(const JCommandPool* pool, uint32_t N, VkCommand
 	: _pool(pool)
 	, _level(level)
 {
-
+	// recycled from the pool's free list, only allocated if there aren't enough free ones
 	_buffers.resize(N);
+	_pool->acquire(N, _buffers.data(), _level);
+}
 
-	// need allocateInfo
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = nullptr; //_pool->pool(); should be set by _pool when you call allocateCommandBuffers
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // primary or secondary
-	// primary can be submitted to a queue for execution, but not called from other buffers
-	// secondary can be called from other buffers, but not submitted directly
-	allocInfo.commandBufferCount = (uint32_t)_buffers.size();
+JCommandBuffers::JCommandBuffers(JCommandBuffers&& other) noexcept
+	: _buffers(std::move(other._buffers))
+	, _level(other._level)
+	, _pool(other._pool)
+{
+	other._buffers.clear();
+}
 
-	if (_pool->allocateCommandBuffers(allocInfo, _buffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate command buffers!");
+JCommandBuffers& JCommandBuffers::operator=(JCommandBuffers&& other) noexcept
+{
+	if (this != &other) {
+		if (!_buffers.empty()) {
+			_pool->release(static_cast<uint32_t>(_buffers.size()), _buffers.data(), _level);
+		}
+		_buffers = std::move(other._buffers);
+		_level = other._level;
+		_pool = other._pool;
+		other._buffers.clear();
 	}
+	return *this;
 }
 
 JCommandBuffers::~JCommandBuffers()
 {
-	_pool->freeCommandBuffers(static_cast<uint32_t>(_buffers.size()), _buffers.data());
+	if (!_buffers.empty()) {
+		_pool->release(static_cast<uint32_t>(_buffers.size()), _buffers.data(), _level);
+	}
 }
 
-JCommandBuffer::JCommandBuffer(const JCommandBuffers* buffers, VkCommandBuffer buff)
-	: _buffers(buffers)
+JCommandBuffer::JCommandBuffer(const JCommandPool* pool, VkCommandBuffer buff)
+	: _pool(pool)
 	, _buff(buff)
 {
 }
@@ -11,20 +11,21 @@ class JCommandBuffers;
 
 // view of a single VkCommandBuffer in a JCommandBuffers
 // has no ownership
+// refers to the pool rather than the JCommandBuffers, so it stays valid if the JCommandBuffers is moved
 class JCommandBuffer
 {
 	friend class JCommandBuffers;
 protected:
-	const JCommandBuffers* _buffers = nullptr;
+	const JCommandPool* _pool = nullptr;
 
 	VkCommandBuffer _buff = VK_NULL_HANDLE;
 
-	JCommandBuffer(const JCommandBuffers* buffers, VkCommandBuffer buff);
+	JCommandBuffer(const JCommandPool* pool, VkCommandBuffer buff);
 
 public:
 	// getters
 	inline VkCommandBuffer buffer() const { return _buff; }
-	inline VkQueue queue() const { return _buffers->queue(); }
+	inline VkQueue queue() const { return _pool->queue(); }
 	
 	// custom methods
 	inline int beginCommandBufferSingleTime() {
@@ -57,6 +58,8 @@ public:
 };
 
 // acquires and manages command buffers from a command pool
+// they go back on the pool's free list when this is destroyed, so they're recycled instead of freed
+// movable, so they can be stored by value (the moved-from object is left empty)
 class JCommandBuffers
 {
 protected:
@@ -72,6 +75,8 @@ public:
 	void operator=(const JCommandBuffers&) = delete;
 
 	JCommandBuffers(const JCommandPool* pool, uint32_t N = 1, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	JCommandBuffers(JCommandBuffers&& other) noexcept;
+	JCommandBuffers& operator=(JCommandBuffers&& other) noexcept;
 	virtual ~JCommandBuffers();
 
 	inline VkQueue queue() const { return _pool->queue(); }
@@ -80,7 +85,7 @@ public:
 		if (index < 0 || index >= _buffers.size()) {
 			throw std::runtime_error("index out of range for JCommandBuffers");
 		}
-		return JCommandBuffer(this, _buffers[index]);
+		return JCommandBuffer(_pool, _buffers[index]);
 	}
 
 	inline uint32_t size() { return _buffers.size(); }
@@ -91,6 +96,8 @@ public:
 		return function(b[0]);
 		// b is automatically destroyed here
 	}
+	// the buffer comes from (and goes back to) the pool's free list, so with a resettable pool
+	// one-shot commands don't allocate anything after the first one
 	template<typename F>
 	static void runWithSingleTimeCommandBuffer(const JCommandPool* pool, F function) {
 		JCommandBuffers b(pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
@@ -98,7 +105,6 @@ public:
 		buffer.beginCommandBufferSingleTime();
 		function(buffer);
 		buffer.endAndSubmitSingleTimeBuffer();
-		return ans;
 		// b is automatically destroyed here
 	}
 };
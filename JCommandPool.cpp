@@ -1,6 +1,7 @@
 #include "JCommandPool.h"
 
 #include <stdexcept>
+#include <algorithm>
 
 
 JCommandPool::JCommandPool(const JDevice* device, VkCommandPoolCreateFlags flags, JQueueType type)
@@ -8,25 +9,14 @@ JCommandPool::JCommandPool(const JDevice* device, VkCommandPoolCreateFlags flags
 	, _flags(flags)
 	, _type(type)
 {
-	const QueueFamilyIndices& queueFamilyIndices = device->queueIndices();
-
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	switch (type) {
-	case JQueueType::JGraphicsQueue:
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-		break;
-	case JQueueType::JPresentQueue:
-		poolInfo.queueFamilyIndex = queueFamilyIndices.presentFamily.value();
-		break;
-	default:
-		throw std::runtime_error("unrecognized queue type for creating command pool");
-	}
+	// transfer and compute pools end up on the graphics family if the device has no dedicated one
+	poolInfo.queueFamilyIndex = device->queueFamily(type);
 	poolInfo.flags = _flags;
 	// flags are TRANSIENT: command buffers are rerecorded often
 	// RESET_COMMAND_BUFFER: allow buffers to be rerecorded individually, otherwise they 
-	// all have to be reset together
-	// we are just recording the command buffers once and not rerecording, so we don't need either flag
+	// all have to be reset together (with reset())
 	if (vkCreateCommandPool(device->device(), &poolInfo, nullptr, &_pool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create command pool!");
 	}
@@ -34,5 +24,55 @@ JCommandPool::JCommandPool(const JDevice* device, VkCommandPoolCreateFlags flags
 
 JCommandPool::~JCommandPool()
 {
-	vkDestroyCommandPool(_device->device(), _pool, nullptr);
+	if (_pool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(_device->device(), _pool, nullptr);
+	}
+}
+
+void JCommandPool::acquire(uint32_t N, VkCommandBuffer* buffers, VkCommandBufferLevel level) const
+{
+	std::vector<VkCommandBuffer>& freeList = _free[levelIndex(level)];
+
+	uint32_t reused = std::min(N, static_cast<uint32_t>(freeList.size()));
+	for (uint32_t i = 0; i < reused; ++i) {
+		buffers[i] = freeList.back();
+		freeList.pop_back();
+	}
+	if (reused == N) {
+		return;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = level; // primary or secondary
+	// primary can be submitted to a queue for execution, but not called from other buffers
+	// secondary can be called from other buffers, but not submitted directly
+	allocInfo.commandBufferCount = N - reused;
+	if (allocateCommandBuffers(allocInfo, buffers + reused) != VK_SUCCESS) {
+		release(reused, buffers, level);
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+	std::vector<VkCommandBuffer>& allocated = _allocated[levelIndex(level)];
+	allocated.insert(allocated.end(), buffers + reused, buffers + N);
+}
+
+void JCommandPool::release(uint32_t N, const VkCommandBuffer* buffers, VkCommandBufferLevel level) const
+{
+	if (!resettable()) {
+		// can't be rerecorded until the pool is reset, reset() puts them back
+		return;
+	}
+	// vkBeginCommandBuffer resets them implicitly when they're reused
+	std::vector<VkCommandBuffer>& freeList = _free[levelIndex(level)];
+	freeList.insert(freeList.end(), buffers, buffers + N);
+}
+
+void JCommandPool::reset(bool releaseResources)
+{
+	if (vkResetCommandPool(_device->device(), _pool, releaseResources ? VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT : 0) != VK_SUCCESS) {
+		throw std::runtime_error("failed to reset command pool!");
+	}
+	for (uint32_t i = 0; i < 2; ++i) {
+		_free[i] = _allocated[i];
+	}
 }
@@ -2,22 +2,40 @@
 
 #include "JDevice.h"
 
+#include <vector>
 
 
+
+// owns a VkCommandPool
+// not copyable or movable, JCommandBuffers (and anything else) allocated from the pool point at it,
+// keep pools behind a pointer if they have to be handed around
+// command buffers are recycled rather than freed: acquire() hands out buffers from a free list and only
+// allocates when it's empty, release() gives them back, and reset() resets the whole pool at once and
+// puts every buffer back on the free list
+// not thread safe, give each thread its own pool
 class JCommandPool
 {
 protected:
-	VkCommandPool _pool;
+	VkCommandPool _pool = VK_NULL_HANDLE;
 	const JDevice* _device;
 	JQueueType _type;
 	VkCommandPoolCreateFlags _flags;
 
+	// indexed by level (primary, secondary)
+	// mutable like the rest of the pool's allocations, which already go through const methods
+	mutable std::vector<VkCommandBuffer> _allocated[2]; // everything ever allocated, all free again after reset()
+	mutable std::vector<VkCommandBuffer> _free[2];
+
+	static inline uint32_t levelIndex(VkCommandBufferLevel level) { return level == VK_COMMAND_BUFFER_LEVEL_SECONDARY ? 1 : 0; }
+
 public:
 	JCommandPool() = delete;
 	JCommandPool(const JCommandPool&) = delete;
 	void operator=(const JCommandPool&) = delete;
 
 	JCommandPool(const JDevice* device, VkCommandPoolCreateFlags flags = 0, JQueueType type = JQueueType::JGraphicsQueue);
+	JCommandPool(JCommandPool&&) = delete;
+	void operator=(JCommandPool&&) = delete;
 	~JCommandPool();
 
 	inline VkCommandPool pool() const { return _pool; }
@@ -26,6 +44,25 @@ public:
 	
 	// custom methods
 	inline VkQueue queue() const { return _device->getQueue(_type); }
+	inline uint32_t queueFamily() const { return _device->queueFamily(_type); }
+	// released buffers can be reused straight away, instead of waiting for reset()
+	inline bool resettable() const { return (_flags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) != 0; }
+	inline size_t allocatedCount(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const { return _allocated[levelIndex(level)].size(); }
+
+	// N buffers from the free list, allocating (all at once) whatever it can't cover
+	void acquire(uint32_t N, VkCommandBuffer* buffers, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const;
+	inline VkCommandBuffer acquire(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const {
+		VkCommandBuffer buffer;
+		acquire(1, &buffer, level);
+		return buffer;
+	}
+	// hands buffers back once the GPU is done with them
+	// if the pool isn't resettable they're only reused after the next reset()
+	void release(uint32_t N, const VkCommandBuffer* buffers, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const;
+	// resets every buffer in the pool with one call and puts them all back on the free list, so nothing
+	// acquired from the pool can still be in use (or held on to)
+	// releaseResources gives the pool's memory back to the driver too
+	void reset(bool releaseResources = false);
 
 
 	// vulkan proxies
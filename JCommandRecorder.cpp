@@ -0,0 +1,163 @@
+#include "JCommandRecorder.h"
+
+#include <stdexcept>
+#include <cstring>
+
+
+JRecordStats& JRecordStats::operator+=(const JRecordStats& other)
+{
+	pipelineBinds += other.pipelineBinds;
+	pipelineBindsElided += other.pipelineBindsElided;
+	vertexBufferBinds += other.vertexBufferBinds;
+	vertexBufferBindsElided += other.vertexBufferBindsElided;
+	indexBufferBinds += other.indexBufferBinds;
+	indexBufferBindsElided += other.indexBufferBindsElided;
+	descriptorSetBinds += other.descriptorSetBinds;
+	descriptorSetBindsElided += other.descriptorSetBindsElided;
+	pushConstants += other.pushConstants;
+	pushConstantsElided += other.pushConstantsElided;
+	draws += other.draws;
+	return *this;
+}
+
+JCommandRecorder::JCommandRecorder(VkCommandBuffer buffer)
+	: _buffer(buffer)
+{
+	invalidate();
+}
+
+void JCommandRecorder::invalidate()
+{
+	for (BindPointState& state : _bindPoints) {
+		state = BindPointState{};
+	}
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i) {
+		_vertexBuffers[i] = VK_NULL_HANDLE;
+		_vertexOffsets[i] = 0;
+	}
+	_indexBuffer = VK_NULL_HANDLE;
+	_indexOffset = 0;
+	_indexType = VK_INDEX_TYPE_UINT16;
+	_pushLayout = VK_NULL_HANDLE;
+	_pushStages = 0;
+	memset(_pushData, 0, sizeof(_pushData));
+	memset(_pushValid, 0, sizeof(_pushValid));
+}
+
+void JCommandRecorder::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+	BindPointState& state = _bindPoints[bindPointIndex(bindPoint)];
+	if (state.pipeline == pipeline) {
+		++_stats.pipelineBindsElided;
+		return;
+	}
+	vkCmdBindPipeline(_buffer, bindPoint, pipeline);
+	state.pipeline = pipeline;
+	++_stats.pipelineBinds;
+}
+
+void JCommandRecorder::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets)
+{
+	if (firstBinding + bindingCount > MAX_VERTEX_BINDINGS) {
+		throw std::runtime_error("too many vertex bindings for command recorder!");
+	}
+
+	bool redundant = true;
+	for (uint32_t i = 0; i < bindingCount && redundant; ++i) {
+		redundant = _vertexBuffers[firstBinding + i] == buffers[i] && _vertexOffsets[firstBinding + i] == offsets[i];
+	}
+	if (redundant) {
+		++_stats.vertexBufferBindsElided;
+		return;
+	}
+
+	vkCmdBindVertexBuffers(_buffer, firstBinding, bindingCount, buffers, offsets);
+	for (uint32_t i = 0; i < bindingCount; ++i) {
+		_vertexBuffers[firstBinding + i] = buffers[i];
+		_vertexOffsets[firstBinding + i] = offsets[i];
+	}
+	++_stats.vertexBufferBinds;
+}
+
+void JCommandRecorder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	if (_indexBuffer == buffer && _indexOffset == offset && _indexType == indexType) {
+		++_stats.indexBufferBindsElided;
+		return;
+	}
+	vkCmdBindIndexBuffer(_buffer, buffer, offset, indexType);
+	_indexBuffer = buffer;
+	_indexOffset = offset;
+	_indexType = indexType;
+	++_stats.indexBufferBinds;
+}
+
+void JCommandRecorder::bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount,
+	const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+	if (firstSet + setCount > MAX_DESCRIPTOR_SETS) {
+		throw std::runtime_error("too many descriptor sets for command recorder!");
+	}
+	BindPointState& state = _bindPoints[bindPointIndex(bindPoint)];
+
+	// sets bound with another layout might not be compatible with this one, so don't trust any of them
+	// (this is stricter than the compatibility rules, but doesn't need to know what's in the layouts)
+	if (state.layout != layout) {
+		for (uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; ++i) {
+			state.sets[i] = VK_NULL_HANDLE;
+		}
+		state.lastSetCount = 0;
+		state.lastDynamicOffsets.clear();
+	}
+
+	bool redundant = state.layout == layout;
+	for (uint32_t i = 0; i < setCount && redundant; ++i) {
+		redundant = state.sets[firstSet + i] == sets[i];
+	}
+	// there's no telling which set a dynamic offset belongs to, so they only match a call for the same sets
+	if (redundant && dynamicOffsetCount > 0) {
+		redundant = state.lastFirstSet == firstSet && state.lastSetCount == setCount
+			&& state.lastDynamicOffsets.size() == dynamicOffsetCount
+			&& memcmp(state.lastDynamicOffsets.data(), dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t)) == 0;
+	}
+	if (redundant) {
+		++_stats.descriptorSetBindsElided;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(_buffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+	state.layout = layout;
+	for (uint32_t i = 0; i < setCount; ++i) {
+		state.sets[firstSet + i] = sets[i];
+	}
+	state.lastFirstSet = firstSet;
+	state.lastSetCount = setCount;
+	state.lastDynamicOffsets.assign(dynamicOffsets, dynamicOffsets + dynamicOffsetCount);
+	++_stats.descriptorSetBinds;
+}
+
+void JCommandRecorder::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+{
+	if (offset + size > MAX_PUSH_CONSTANT_SIZE) {
+		throw std::runtime_error("push constants out of range for command recorder!");
+	}
+	if (_pushLayout != layout || _pushStages != stages) {
+		memset(_pushValid, 0, sizeof(_pushValid));
+		_pushLayout = layout;
+		_pushStages = stages;
+	}
+
+	bool redundant = memcmp(_pushData + offset, data, size) == 0;
+	for (uint32_t i = offset; i < offset + size && redundant; ++i) {
+		redundant = _pushValid[i] != 0;
+	}
+	if (redundant) {
+		++_stats.pushConstantsElided;
+		return;
+	}
+
+	vkCmdPushConstants(_buffer, layout, stages, offset, size, data);
+	memcpy(_pushData + offset, data, size);
+	memset(_pushValid + offset, 1, size);
+	++_stats.pushConstants;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "JCommandBuffer.h"
+
+// how many bind calls a JCommandRecorder issued and how many it dropped as redundant
+struct JRecordStats {
+	uint64_t pipelineBinds = 0;
+	uint64_t pipelineBindsElided = 0;
+	uint64_t vertexBufferBinds = 0;
+	uint64_t vertexBufferBindsElided = 0;
+	uint64_t indexBufferBinds = 0;
+	uint64_t indexBufferBindsElided = 0;
+	uint64_t descriptorSetBinds = 0;
+	uint64_t descriptorSetBindsElided = 0;
+	uint64_t pushConstants = 0;
+	uint64_t pushConstantsElided = 0;
+	uint64_t draws = 0;
+
+	inline uint64_t issued() const { return pipelineBinds + vertexBufferBinds + indexBufferBinds + descriptorSetBinds + pushConstants; }
+	inline uint64_t elided() const {
+		return pipelineBindsElided + vertexBufferBindsElided + indexBufferBindsElided + descriptorSetBindsElided + pushConstantsElided;
+	}
+
+	JRecordStats& operator+=(const JRecordStats& other);
+};
+
+// records into a command buffer, remembering what's bound so binding the same thing again is skipped
+// starts out assuming nothing is bound, call invalidate() whenever the state is disturbed behind its back
+// (vkCmdExecuteCommands, or recording into the buffer directly)
+// one per command buffer per thread, not thread safe
+class JCommandRecorder
+{
+public:
+	static const uint32_t MAX_VERTEX_BINDINGS = 16;
+	static const uint32_t MAX_DESCRIPTOR_SETS = 8;
+	static const uint32_t MAX_PUSH_CONSTANT_SIZE = 256; // the spec only guarantees 128, but some devices have more
+
+protected:
+	VkCommandBuffer _buffer;
+	JRecordStats _stats;
+
+	// graphics and compute have separate bind points, so separate state
+	struct BindPointState {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE; // the sets below were bound with this
+		VkDescriptorSet sets[MAX_DESCRIPTOR_SETS] = {};
+		// the last call's dynamic offsets, only compared against a call binding exactly the same sets
+		uint32_t lastFirstSet = 0;
+		uint32_t lastSetCount = 0;
+		std::vector<uint32_t> lastDynamicOffsets;
+	};
+	BindPointState _bindPoints[2];
+
+	VkBuffer _vertexBuffers[MAX_VERTEX_BINDINGS] = {};
+	VkDeviceSize _vertexOffsets[MAX_VERTEX_BINDINGS] = {};
+
+	VkBuffer _indexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize _indexOffset = 0;
+	VkIndexType _indexType = VK_INDEX_TYPE_UINT16;
+
+	VkPipelineLayout _pushLayout = VK_NULL_HANDLE; // _pushData is only meaningful for this layout
+	VkShaderStageFlags _pushStages = 0; // and these stages
+	uint8_t _pushData[MAX_PUSH_CONSTANT_SIZE];
+	uint8_t _pushValid[MAX_PUSH_CONSTANT_SIZE]; // which bytes of _pushData have been pushed
+
+	static inline uint32_t bindPointIndex(VkPipelineBindPoint bindPoint) { return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0; }
+
+public:
+	JCommandRecorder() = delete;
+	JCommandRecorder(const JCommandRecorder&) = delete;
+	void operator=(const JCommandRecorder&) = delete;
+
+	JCommandRecorder(VkCommandBuffer buffer);
+	inline JCommandRecorder(const JCommandBuffer& buffer) : JCommandRecorder(buffer.buffer()) {}
+
+	inline VkCommandBuffer buffer() const { return _buffer; }
+	inline const JRecordStats& stats() const { return _stats; }
+
+	// forget everything that's bound, the next bind of anything is always issued
+	void invalidate();
+
+	void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+	void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+	inline void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0) { bindVertexBuffers(binding, 1, &buffer, &offset); }
+	void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	void bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount,
+		const VkDescriptorSet* sets, uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+	void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+	// draws don't change any state, these just count them
+	inline void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+		vkCmdDraw(_buffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		++_stats.draws;
+	}
+	inline void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+		vkCmdDrawIndexed(_buffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		++_stats.draws;
+	}
+};
+
@@ -0,0 +1,201 @@
+#include "JConfig.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+
+static std::string trim(const std::string& s)
+{
+	size_t begin = 0;
+	size_t end = s.size();
+	while (begin < end && std::isspace(static_cast<unsigned char>(s[begin]))) {
+		++begin;
+	}
+	while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1]))) {
+		--end;
+	}
+	return s.substr(begin, end - begin);
+}
+
+static std::string lower(std::string s)
+{
+	std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return s;
+}
+
+static bool parseBool(const std::string& value)
+{
+	std::string v = lower(value);
+	if (v == "true" || v == "1" || v == "on" || v == "yes") {
+		return true;
+	}
+	if (v == "false" || v == "0" || v == "off" || v == "no") {
+		return false;
+	}
+	throw std::runtime_error("invalid boolean setting: " + value + "!");
+}
+
+void JConfig::load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open config file " + filename + "!");
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) {
+			continue;
+		}
+		size_t equals = line.find('=');
+		if (equals == std::string::npos) {
+			throw std::runtime_error("invalid line in config file " + filename + ": " + line + "!");
+		}
+		set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+	}
+}
+
+void JConfig::parseArgs(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0) {
+			throw std::runtime_error("unexpected argument " + arg + "!");
+		}
+		arg = arg.substr(2);
+
+		std::string key;
+		std::string value;
+		size_t equals = arg.find('=');
+		if (equals != std::string::npos) {
+			key = arg.substr(0, equals);
+			value = arg.substr(equals + 1);
+		}
+		else if (arg == "low_latency" && (i + 1 >= argc || std::string(argv[i + 1]).compare(0, 2, "--") == 0)) {
+			// a flag on its own turns it on
+			key = arg;
+			value = "true";
+		}
+		else if (i + 1 < argc) {
+			key = arg;
+			value = argv[++i];
+		}
+		else {
+			throw std::runtime_error("missing value for --" + arg + "!");
+		}
+
+		if (key == "config") {
+			load(value);
+		}
+		else {
+			set(key, value);
+		}
+	}
+}
+
+void JConfig::set(const std::string& key, const std::string& value)
+{
+	// accept dashes too, they're more usual on the command line
+	std::string k = key;
+	std::replace(k.begin(), k.end(), '-', '_');
+
+	if (k == "frames_in_flight") {
+		int n = 0;
+		try {
+			n = std::stoi(value);
+		}
+		catch (const std::exception&) {
+			throw std::runtime_error("invalid frames_in_flight: " + value + "!");
+		}
+		if (n < static_cast<int>(MIN_FRAMES_IN_FLIGHT) || n > static_cast<int>(MAX_FRAMES_IN_FLIGHT)) {
+			throw std::runtime_error("frames_in_flight must be between 1 and 4!");
+		}
+		framesInFlight = static_cast<uint32_t>(n);
+	}
+	else if (k == "present_modes" || k == "present_mode") {
+		std::vector<VkPresentModeKHR> modes;
+		std::stringstream list(value);
+		std::string name;
+		while (std::getline(list, name, ',')) {
+			name = trim(name);
+			if (!name.empty()) {
+				modes.push_back(parsePresentMode(name));
+			}
+		}
+		if (modes.empty()) {
+			throw std::runtime_error("present_modes can't be empty!");
+		}
+		presentModes = modes;
+	}
+	else if (k == "low_latency") {
+		lowLatency = parseBool(value);
+	}
+	else if (k == "latency_stats") {
+		latencyStatsFile = value;
+	}
+	else if (k == "mode") {
+		std::string m = lower(value);
+		if (m == "app") {
+			mode = JRunMode::JApp;
+		}
+		else if (m == "test_memory_types") {
+			mode = JRunMode::JTestMemoryTypes;
+		}
+		else if (m == "bench_allocator") {
+			mode = JRunMode::JBenchAllocator;
+		}
+		else if (m == "bench_recording") {
+			mode = JRunMode::JBenchRecording;
+		}
+		else {
+			throw std::runtime_error("unknown mode " + value + "!");
+		}
+	}
+	else {
+		throw std::runtime_error("unknown setting " + key + "!");
+	}
+}
+
+std::string JConfig::toJson() const
+{
+	std::ostringstream out;
+	out << "{\"framesInFlight\":" << framesInFlight << ",\"presentModes\":[";
+	for (size_t i = 0; i < presentModes.size(); ++i) {
+		out << (i ? "," : "") << "\"" << presentModeName(presentModes[i]) << "\"";
+	}
+	out << "],\"lowLatency\":" << (lowLatency ? "true" : "false") << "}";
+	return out.str();
+}
+
+VkPresentModeKHR JConfig::parsePresentMode(const std::string& name)
+{
+	std::string n = lower(name);
+	if (n == "immediate") {
+		return VK_PRESENT_MODE_IMMEDIATE_KHR; // no vsync, tears, lowest latency
+	}
+	if (n == "mailbox") {
+		return VK_PRESENT_MODE_MAILBOX_KHR; // triple buffering, newest frame replaces the queued one
+	}
+	if (n == "fifo") {
+		return VK_PRESENT_MODE_FIFO_KHR; // ordinary vsync, always available
+	}
+	if (n == "fifo_relaxed") {
+		return VK_PRESENT_MODE_FIFO_RELAXED_KHR; // vsync, but tears instead of waiting when a frame is late
+	}
+	throw std::runtime_error("unknown present mode " + name + "!");
+}
+
+const char* JConfig::presentModeName(VkPresentModeKHR mode)
+{
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// settings that trade throughput against latency, so they can be tuned per machine without rebuilding
+// read from a config file of "key = value" lines (# starts a comment), then overridden from the
+// command line with --key=value or --key value, e.g.
+//   frames_in_flight = 3
+//   present_modes = immediate, mailbox, fifo
+//   low_latency = true
+//   latency_stats = latency_stats.jsonl
+//   mode = test_memory_types (or bench_allocator, bench_recording)
+
+// what the program does, the checks and benchmarks print their results and exit
+enum class JRunMode {
+	JApp, // the renderer
+	JTestMemoryTypes, // the memory type policy against made up GPUs, see JMemoryTypeTests
+	JBenchAllocator, // JMemoryAllocator against vkAllocateMemory, see JAllocatorBenchmark
+	JBenchRecording // recording 10k draws on 1 to N threads
+};
+
+struct JConfig {
+	static const uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+	// how many frames the CPU can get ahead of the GPU, more smooths out hitches but adds latency
+	uint32_t framesInFlight = 2;
+	// in order of preference, the first one the surface supports is used, FIFO if none of them are
+	std::vector<VkPresentModeKHR> presentModes = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+	// wait for the GPU to finish the last frame before sampling input, instead of only waiting for a frame
+	// slot to come free (which is framesInFlight frames old), costs some throughput
+	bool lowLatency = false;
+	// latency stats get appended to this file (one json object per line) with the settings they were measured with
+	std::string latencyStatsFile = "latency_stats.jsonl";
+	JRunMode mode = JRunMode::JApp;
+
+	// throws if the file can't be read or has anything in it that isn't a valid setting
+	void load(const std::string& filename);
+	// throws on unknown options and bad values, argv[0] is skipped
+	// --config=file loads the file then and there, so later options override it
+	void parseArgs(int argc, char** argv);
+	// a single setting, both of the above come through here
+	void set(const std::string& key, const std::string& value);
+
+	// one line of json with every setting, for tagging stats with what they were measured under
+	std::string toJson() const;
+
+	static VkPresentModeKHR parsePresentMode(const std::string& name);
+	static const char* presentModeName(VkPresentModeKHR mode);
+};
@@ -0,0 +1,32 @@
+#include "JDeletionQueue.h"
+
+
+JDeletionQueue::~JDeletionQueue()
+{
+	flush();
+}
+
+void JDeletionQueue::enqueue(uint64_t value, std::function<void()> destroy)
+{
+	_pending.emplace(value, std::move(destroy));
+}
+
+void JDeletionQueue::retire(uint64_t completedValue)
+{
+	// one at a time, taken out before it runs, a destroy callback can enqueue more (which might be
+	// retired already, and have to run in this call too)
+	while (!_pending.empty() && _pending.begin()->first <= completedValue) {
+		std::function<void()> destroy = std::move(_pending.begin()->second);
+		_pending.erase(_pending.begin());
+		destroy();
+	}
+}
+
+void JDeletionQueue::flush()
+{
+	while (!_pending.empty()) {
+		std::function<void()> destroy = std::move(_pending.begin()->second);
+		_pending.erase(_pending.begin());
+		destroy();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+// destroys things once the GPU is done with them, instead of waiting for the device to go idle
+// everything is keyed by a value that only ever grows (normally a JTimeline value):
+// enqueue with the value of the last submission that could be using the resource, and call
+// retire() with the value the GPU has finished, everything at or below it gets destroyed
+// not thread safe
+class JDeletionQueue
+{
+protected:
+	std::multimap<uint64_t, std::function<void()>> _pending; // sorted by value, so retire stops early
+
+public:
+	JDeletionQueue() = default;
+	JDeletionQueue(const JDeletionQueue&) = delete;
+	void operator=(const JDeletionQueue&) = delete;
+
+	// runs anything that's left, only safe once the device is idle
+	~JDeletionQueue();
+
+	inline size_t size() const { return _pending.size(); }
+
+	// destroy gets called once value has been retired
+	void enqueue(uint64_t value, std::function<void()> destroy);
+
+	// takes ownership of resource (a JBuffer, JImage...) and lets it go once value has been retired
+	template<typename T>
+	void defer(uint64_t value, T&& resource) {
+		// std::function has to be copyable, and most resources aren't
+		auto owned = std::make_shared<std::decay_t<T>>(std::forward<T>(resource));
+		enqueue(value, [owned]() mutable { owned.reset(); });
+	}
+
+	// the GPU has finished everything up to and including completedValue
+	void retire(uint64_t completedValue);
+
+	// destroys everything, only safe once the device is idle
+	void flush();
+};
+
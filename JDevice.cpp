@@ -1,6 +1,8 @@
 #include "JDevice.h"
+#include "JMemoryAllocator.h"
 #include <set>
 #include <stdexcept>
+#include <cstring>
 
 
 JDevice::JDevice(VkPhysicalDevice physical, VkSurfaceKHR surface, const std::vector<const char*>& deviceExtensions, bool enableValidationLayers, const std::vector<const char*>& validationLayers)
@@ -10,14 +12,41 @@ JDevice::JDevice(VkPhysicalDevice physical, VkSurfaceKHR surface, const std::vec
 	, _device(VK_NULL_HANDLE)
 	, _graphicsQueue(VK_NULL_HANDLE)
 	, _presentQueue(VK_NULL_HANDLE)
-	, _deviceExtensions(&deviceExtensions)
+	, _transferQueue(VK_NULL_HANDLE)
+	, _computeQueue(VK_NULL_HANDLE)
+	, _deviceExtensions(deviceExtensions)
 {
 	_indices = findQueueFamilies(_physical, _surface);
 
+	// optional extensions, only enabled if they're there
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_physical, &properties);
+	if (properties.apiVersion >= VK_API_VERSION_1_1 && supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+		_deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		_memoryBudget = true;
+	}
+#ifdef VK_EXT_pipeline_creation_feedback
+	if (supportsExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)) {
+		_deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+		_creationFeedback = true;
+	}
+#endif
+	if (supportsExtendedDynamicState()) {
+#ifdef VK_EXT_extended_dynamic_state
+		_deviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		_extendedDynamicState = true;
+#endif
+	}
+
 	// vector of queue infos
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	// set of distinct queue indices
-	std::set<uint32_t> uniqueQueueFamilies = { _indices.graphicsFamily.value(), _indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = {
+		queueFamily(JQueueType::JGraphicsQueue),
+		queueFamily(JQueueType::JPresentQueue),
+		queueFamily(JQueueType::JTransferQueue),
+		queueFamily(JQueueType::JComputeQueue)
+	};
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -29,17 +58,33 @@ JDevice::JDevice(VkPhysicalDevice physical, VkSurfaceKHR surface, const std::vec
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
-	// don't need any device features yet, so leave blank
+	// don't need any core 1.0 device features yet, so leave blank
 	VkPhysicalDeviceFeatures deviceFeatures{};
 
+	// frames, uploads and deletion are all synchronised with a timeline semaphore (core in 1.2)
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+#ifdef VK_EXT_extended_dynamic_state
+	// lets pipelines leave cull mode, front face, topology and depth state to the command buffer
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+	dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+	if (_extendedDynamicState) {
+		timelineFeatures.pNext = &dynamicStateFeatures;
+	}
+#endif
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &timelineFeatures;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(_deviceExtensions->size());
-	createInfo.ppEnabledExtensionNames = _deviceExtensions->data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(_deviceExtensions.size());
+	createInfo.ppEnabledExtensionNames = _deviceExtensions.data();
 
 
 	// not needed for modern vulkan, but for compatibility, include validation layers on device createinfo
@@ -60,9 +105,72 @@ JDevice::JDevice(VkPhysicalDevice physical, VkSurfaceKHR surface, const std::vec
 	// 0 is the index of the queue in the family, since we're only creating one.
 	vkGetDeviceQueue(_device, _indices.graphicsFamily.value(), 0, &_graphicsQueue);
 	vkGetDeviceQueue(_device, _indices.presentFamily.value(), 0, &_presentQueue);
+	// falls back to the graphics queue when there's no dedicated family
+	vkGetDeviceQueue(_device, queueFamily(JQueueType::JTransferQueue), 0, &_transferQueue);
+	vkGetDeviceQueue(_device, queueFamily(JQueueType::JComputeQueue), 0, &_computeQueue);
+
+	if (_extendedDynamicState) {
+		loadExtendedDynamicState();
+	}
+
+	_allocator = new JMemoryAllocator(this);
 }
 
 JDevice::~JDevice()
 {
+	delete _allocator; _allocator = nullptr;
 	vkDestroyDevice(_device, nullptr);
 }
+
+bool JDevice::supportsExtension(const char* name) const
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(_physical, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(_physical, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JDevice::supportsExtendedDynamicState() const
+{
+#ifdef VK_EXT_extended_dynamic_state
+	if (!supportsExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+		return false;
+	}
+	// the extension being there doesn't mean the feature is
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+	dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamicStateFeatures;
+	vkGetPhysicalDeviceFeatures2(_physical, &features);
+	return dynamicStateFeatures.extendedDynamicState == VK_TRUE;
+#else
+	return false; // headers too old to know about it
+#endif
+}
+
+void JDevice::loadExtendedDynamicState()
+{
+#ifdef VK_EXT_extended_dynamic_state
+	_dynamicState.setCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetCullModeEXT"));
+	_dynamicState.setFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetFrontFaceEXT"));
+	_dynamicState.setPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetPrimitiveTopologyEXT"));
+	_dynamicState.setDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetDepthTestEnableEXT"));
+	_dynamicState.setDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetDepthWriteEnableEXT"));
+	_dynamicState.setDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(_device, "vkCmdSetDepthCompareOpEXT"));
+	if (_dynamicState.setCullMode == nullptr || _dynamicState.setFrontFace == nullptr || _dynamicState.setPrimitiveTopology == nullptr
+		|| _dynamicState.setDepthTestEnable == nullptr || _dynamicState.setDepthWriteEnable == nullptr || _dynamicState.setDepthCompareOp == nullptr) {
+		// enabled but missing, don't use any of it
+		_dynamicState = JExtendedDynamicState{};
+		_extendedDynamicState = false;
+	}
+#endif
+}
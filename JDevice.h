@@ -7,8 +7,25 @@
 #include <string>
 
 
+class JMemoryAllocator;
+
+// VK_EXT_extended_dynamic_state entry points, null unless the extension is enabled
+// (extension commands aren't exported by the loader, they have to be looked up on the device)
+struct JExtendedDynamicState {
+#ifdef VK_EXT_extended_dynamic_state
+	PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+	PFN_vkCmdSetFrontFaceEXT setFrontFace = nullptr;
+	PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology = nullptr;
+	PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable = nullptr;
+	PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable = nullptr;
+	PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp = nullptr;
+#endif
+};
+
+// transfer and compute queues are the dedicated ones if the device has them, otherwise
+// they're the graphics queue
 enum class JQueueType {
-	JGraphicsQueue, JPresentQueue
+	JGraphicsQueue, JPresentQueue, JTransferQueue, JComputeQueue
 };
 
 class JDevice
@@ -23,10 +40,20 @@ protected:
 
 	VkQueue _graphicsQueue = VK_NULL_HANDLE;
 	VkQueue _presentQueue = VK_NULL_HANDLE;
+	VkQueue _transferQueue = VK_NULL_HANDLE;
+	VkQueue _computeQueue = VK_NULL_HANDLE;
+
+	// owned by the device, every JBuffer and JImage sub-allocates from it
+	JMemoryAllocator* _allocator = nullptr;
 
 	//bool reference = false;
 
-	const std::vector<const char*>* _deviceExtensions;
+	// the requested extensions plus optional ones the device turned out to support
+	std::vector<const char*> _deviceExtensions;
+	bool _memoryBudget = false; // VK_EXT_memory_budget is enabled
+	bool _extendedDynamicState = false; // VK_EXT_extended_dynamic_state is enabled (and _dynamicState loaded)
+	JExtendedDynamicState _dynamicState;
+	bool _creationFeedback = false; // VK_EXT_pipeline_creation_feedback is enabled
 
 public:
 	JDevice() = delete;
@@ -40,7 +67,21 @@ public:
 	inline VkPhysicalDevice physical() const { return _physical; }
 	inline VkQueue graphicsQueue() const { return _graphicsQueue; }
 	inline VkQueue presentQueue() const { return _presentQueue; }
+	inline VkQueue transferQueue() const { return _transferQueue; }
+	inline VkQueue computeQueue() const { return _computeQueue; }
+	// true if transfer/compute work goes to a queue family of its own
+	inline bool hasDedicatedTransfer() const { return _indices.transferFamily.has_value(); }
+	inline bool hasDedicatedCompute() const { return _indices.computeFamily.has_value(); }
 	inline const QueueFamilyIndices& queueIndices() const { return _indices; }
+	inline JMemoryAllocator* allocator() const { return _allocator; }
+	inline const std::vector<const char*>& enabledExtensions() const { return _deviceExtensions; }
+	// the driver's per heap budget and usage can be queried (needs Vulkan 1.1 for vkGetPhysicalDeviceMemoryProperties2)
+	inline bool hasMemoryBudget() const { return _memoryBudget; }
+	// cull mode, front face, topology and depth test state can be left dynamic in pipelines
+	inline bool hasExtendedDynamicState() const { return _extendedDynamicState; }
+	inline const JExtendedDynamicState& extendedDynamicState() const { return _dynamicState; }
+	// pipeline creation can report whether it hit the pipeline cache and how long it took
+	inline bool hasCreationFeedback() const { return _creationFeedback; }
 
 	inline VkQueue getQueue(JQueueType type) const {
 		switch (type) {
@@ -48,10 +89,32 @@ public:
 			return _graphicsQueue;
 		case JQueueType::JPresentQueue:
 			return _presentQueue;
+		case JQueueType::JTransferQueue:
+			return _transferQueue;
+		case JQueueType::JComputeQueue:
+			return _computeQueue;
+		}
+		return VK_NULL_HANDLE;
+	}
+	// the family of the queue getQueue(type) returns, for command pools and ownership transfers
+	inline uint32_t queueFamily(JQueueType type) const {
+		switch (type) {
+		case JQueueType::JPresentQueue:
+			return _indices.presentFamily.value();
+		case JQueueType::JTransferQueue:
+			return _indices.transferFamily.value_or(_indices.graphicsFamily.value());
+		case JQueueType::JComputeQueue:
+			// some family has to support graphics and compute both, in practice it's the graphics one
+			return _indices.computeFamily.value_or(_indices.graphicsFamily.value());
+		default:
+			return _indices.graphicsFamily.value();
 		}
 	}
 private:
 	//void nullify();
+	bool supportsExtension(const char* name) const;
+	bool supportsExtendedDynamicState() const;
+	void loadExtendedDynamicState();
 
 };
 
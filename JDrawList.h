@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// everything one indexed draw needs that isn't pipeline state
+struct JDraw {
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t vertexOffset = 0;
+	uint32_t instanceCount = 1;
+	uint32_t uniformOffset = 0; // offset of the draw's uniforms from the start of the frame's uniforms
+
+	inline bool operator==(const JDraw& other) const {
+		return vertexBuffer == other.vertexBuffer && indexBuffer == other.indexBuffer && indexType == other.indexType
+			&& indexCount == other.indexCount && firstIndex == other.firstIndex && vertexOffset == other.vertexOffset
+			&& instanceCount == other.instanceCount && uniformOffset == other.uniformOffset;
+	}
+	inline bool operator!=(const JDraw& other) const { return !(*this == other); }
+};
+
+// the draws for one frame, in the order they're recorded
+// rebuilt every frame, clear() keeps the memory
+// version() only changes when the draws actually differ from the last time it was checked, so a list that's
+// rebuilt the same way every frame keeps its version, and recordings made from it can be reused
+class JDrawList
+{
+protected:
+	std::vector<JDraw> _draws;
+	std::vector<JDraw> _previous; // what the list held the last time version() was called
+	uint64_t _version = 0;
+	bool _checked = true; // _version is up to date with _draws
+
+public:
+	JDrawList() = default;
+	JDrawList(const JDrawList&) = delete;
+	void operator=(const JDrawList&) = delete;
+
+	inline size_t size() const { return _draws.size(); }
+	inline bool empty() const { return _draws.empty(); }
+	inline const JDraw& operator[](size_t index) const { return _draws[index]; }
+	inline const JDraw* data() const { return _draws.data(); }
+
+	inline void reserve(size_t n) { _draws.reserve(n); }
+	inline void clear() {
+		if (_checked) {
+			_previous.swap(_draws);
+		}
+		_draws.clear();
+		_checked = false;
+	}
+	inline void add(const JDraw& draw) {
+		if (_checked) {
+			_previous = _draws; // adding on without a clear(), only happens if the list isn't rebuilt every frame
+		}
+		_draws.push_back(draw);
+		_checked = false;
+	}
+
+	// compares the draws with the ones from the last call, bumping the version if they changed
+	inline uint64_t version() {
+		if (!_checked) {
+			if (_draws.size() != _previous.size() || !std::equal(_draws.begin(), _draws.end(), _previous.begin())) {
+				++_version;
+			}
+			_checked = true;
+		}
+		return _version;
+	}
+};
+
@@ -0,0 +1,148 @@
+#include "JDrawQueue.h"
+
+#include <algorithm>
+#include <functional>
+
+
+namespace JSortKey {
+	static inline uint64_t field(uint32_t value, uint32_t bits) { return static_cast<uint64_t>(value) & ((1ull << bits) - 1); }
+
+	uint32_t quantizeDepth(float depth)
+	{
+		const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+		depth = std::min(std::max(depth, 0.0f), 1.0f);
+		return static_cast<uint32_t>(depth * maxDepth + 0.5f);
+	}
+
+	uint64_t opaque(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		return (field(pass, PASS_BITS) << (PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS))
+			| (field(pipeline, PIPELINE_BITS) << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS))
+			| (field(material, MATERIAL_BITS) << (MESH_BITS + DEPTH_BITS))
+			| (field(mesh, MESH_BITS) << DEPTH_BITS)
+			| field(quantizeDepth(depth), DEPTH_BITS);
+	}
+
+	uint64_t transparent(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+		return (field(pass, PASS_BITS) << (DEPTH_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS))
+			| (field(maxDepth - quantizeDepth(depth), DEPTH_BITS) << (PIPELINE_BITS + MATERIAL_BITS + MESH_BITS))
+			| (field(pipeline, PIPELINE_BITS) << (MATERIAL_BITS + MESH_BITS))
+			| (field(material, MATERIAL_BITS) << MESH_BITS)
+			| field(mesh, MESH_BITS);
+	}
+}
+
+void JDrawQueue::push(uint64_t key, const JDraw& draw)
+{
+	JDrawPacket packet;
+	packet.key = key;
+	packet.draw = static_cast<uint32_t>(_draws.size());
+	_draws.push_back(draw);
+
+	// keys pushed in order don't need sorting, which is common when the scene hasn't changed much
+	if (_sorted && !_packets.empty() && _packets.back().key > key) {
+		_sorted = false;
+	}
+	_packets.push_back(packet);
+}
+
+void JDrawQueue::sort(JThreadPool* threads)
+{
+	if (_sorted) {
+		return;
+	}
+	uint32_t chunkCount = 1;
+	if (threads != nullptr) {
+		chunkCount = static_cast<uint32_t>(std::min<size_t>(_packets.size() / MIN_PACKETS_PER_CHUNK, threads->slotCount()));
+		chunkCount = std::max<uint32_t>(chunkCount, 1);
+	}
+	sortChunks(chunkCount > 1 ? threads : nullptr, chunkCount);
+	_sorted = true;
+}
+
+void JDrawQueue::sortChunks(JThreadPool* threads, uint32_t chunkCount)
+{
+	const uint32_t RADIX = 256;
+	size_t count = _packets.size();
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	_scratch.resize(count);
+	_histograms.resize(static_cast<size_t>(chunkCount) * RADIX);
+
+	// each chunk of the packets is counted and scattered by one thread
+	auto forEachChunk = [threads, chunkCount](const std::function<void(uint32_t)>& function) {
+		if (threads == nullptr) {
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+				function(chunk);
+			}
+		}
+		else {
+			threads->parallelFor(chunkCount, [&function](uint32_t, uint32_t chunk) { function(chunk); });
+		}
+	};
+
+	JDrawPacket* source = _packets.data();
+	JDrawPacket* destination = _scratch.data();
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		// count how many keys in each chunk have each value of this byte
+		forEachChunk([this, source, count, chunkSize, shift](uint32_t chunk) {
+			uint32_t* histogram = &_histograms[static_cast<size_t>(chunk) * RADIX];
+			std::fill(histogram, histogram + RADIX, 0);
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; ++i) {
+				++histogram[(source[i].key >> shift) & (RADIX - 1)];
+			}
+		});
+
+		// if every key has the same byte here the pass wouldn't move anything (the pipeline/material
+		// bytes are often like this), so skip it
+		bool allSame = false;
+		for (uint32_t digit = 0; digit < RADIX && !allSame; ++digit) {
+			size_t total = 0;
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+				total += _histograms[static_cast<size_t>(chunk) * RADIX + digit];
+			}
+			allSame = total == count;
+		}
+		if (allSame) {
+			continue;
+		}
+
+		// turn the counts into where each chunk writes each digit, digit major and chunk minor, so the
+		// earlier chunks come first within a digit and the sort stays stable
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX; ++digit) {
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+				uint32_t& slot = _histograms[static_cast<size_t>(chunk) * RADIX + digit];
+				uint32_t n = slot;
+				slot = offset;
+				offset += n;
+			}
+		}
+
+		forEachChunk([this, source, destination, count, chunkSize, shift](uint32_t chunk) {
+			uint32_t* offsets = &_histograms[static_cast<size_t>(chunk) * RADIX];
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; ++i) {
+				destination[offsets[(source[i].key >> shift) & (RADIX - 1)]++] = source[i];
+			}
+		});
+		std::swap(source, destination);
+	}
+
+	// the passes that ran left the result in the scratch buffer
+	if (source != _packets.data()) {
+		_packets.swap(_scratch);
+	}
+}
+
+void JDrawQueue::copyTo(JDrawList& list, JThreadPool* threads)
+{
+	sort(threads);
+	list.reserve(list.size() + _packets.size());
+	for (const JDrawPacket& packet : _packets) {
+		list.add(_draws[packet.draw]);
+	}
+}
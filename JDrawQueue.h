@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "JDrawList.h"
+#include "JThreadPool.h"
+
+// builds the 64 bit keys draws are sorted by, most significant field first
+// opaque:      pass (4) | pipeline (12) | material (12) | mesh (12) | depth (24)
+//              everything sharing state ends up together, and front to back within it for early z
+// transparent: pass (4) | inverted depth (24) | pipeline (12) | material (12) | mesh (12)
+//              back to front has to win over state changes, or the blending comes out wrong
+// ids are truncated to their field, depth is clamped to [0, 1] (view depth over the far plane)
+namespace JSortKey {
+	const uint32_t PASS_BITS = 4;
+	const uint32_t PIPELINE_BITS = 12;
+	const uint32_t MATERIAL_BITS = 12;
+	const uint32_t MESH_BITS = 12;
+	const uint32_t DEPTH_BITS = 24;
+
+	uint32_t quantizeDepth(float depth);
+
+	uint64_t opaque(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+	uint64_t transparent(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	inline uint32_t pass(uint64_t key) { return static_cast<uint32_t>(key >> (64 - PASS_BITS)); }
+}
+
+// a draw waiting to be sorted
+struct JDrawPacket {
+	uint64_t key;
+	uint32_t draw; // index into the queue's draws
+};
+
+// collects a frame's draws with their sort keys, sorts them, and hands them over to a JDrawList in order
+// the sort is an LSD radix sort, a byte per pass, spread over a JThreadPool when there are enough packets
+// (it's stable, so draws with equal keys stay in the order they were pushed)
+class JDrawQueue
+{
+protected:
+	std::vector<JDraw> _draws;
+	std::vector<JDrawPacket> _packets;
+	std::vector<JDrawPacket> _scratch; // the radix sort ping pongs between this and _packets
+	std::vector<uint32_t> _histograms; // [chunk][256], counts then scatter offsets
+	bool _sorted = true;
+
+	void sortChunks(JThreadPool* threads, uint32_t chunkCount);
+
+public:
+	// below this many packets per thread, it isn't worth handing the sort to other threads
+	static const uint32_t MIN_PACKETS_PER_CHUNK = 4096;
+
+	JDrawQueue() = default;
+	JDrawQueue(const JDrawQueue&) = delete;
+	void operator=(const JDrawQueue&) = delete;
+
+	inline size_t size() const { return _packets.size(); }
+	inline bool empty() const { return _packets.empty(); }
+	inline bool sorted() const { return _sorted; }
+	inline const JDrawPacket& packet(size_t index) const { return _packets[index]; }
+
+	inline void reserve(size_t n) { _draws.reserve(n); _packets.reserve(n); }
+	inline void clear() { _draws.clear(); _packets.clear(); _sorted = true; }
+	void push(uint64_t key, const JDraw& draw);
+
+	// threads can be nullptr, then it's all done on the calling thread
+	void sort(JThreadPool* threads = nullptr);
+
+	// appends the draws to list in key order, sorting first if needed
+	void copyTo(JDrawList& list, JThreadPool* threads = nullptr);
+};
+
@@ -0,0 +1,75 @@
+#include "JFrameAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include "JMemoryAllocator.h"
+
+
+JFrameAllocator::JFrameAllocator(const JDevice* device, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage)
+	: _pDevice(device)
+	, _frameCount(frameCount)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_pDevice->physical(), &properties);
+	_uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+	_storageAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+
+	// keep every region aligned for anything allocated from it, so offsets relative to the
+	// buffer are too, and flushing one region never touches the atoms of another
+	VkDeviceSize regionAlignment = std::max({ _uniformAlignment, _storageAlignment,
+		_pDevice->allocator()->nonCoherentAtomSize(), (VkDeviceSize)256 });
+	_frameSize = (frameSize + regionAlignment - 1) & ~(regionAlignment - 1);
+
+	_buffer = new JBuffer(
+		_pDevice,
+		_frameSize * _frameCount,
+		usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+JFrameAllocator::~JFrameAllocator()
+{
+	delete _buffer; _buffer = nullptr;
+}
+
+void JFrameAllocator::beginFrame(uint32_t frame)
+{
+	if (frame >= _frameCount) {
+		throw std::runtime_error("frame out of range for frame allocator!");
+	}
+	_frame = frame;
+	_head = 0;
+}
+
+JFrameAllocation JFrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = (_head + alignment - 1) & ~(alignment - 1);
+	if (offset + size > _frameSize) {
+		throw std::runtime_error("frame allocator is out of space for this frame!");
+	}
+	_head = offset + size;
+	_peak = std::max(_peak, _head);
+
+	JFrameAllocation allocation;
+	allocation.buffer = _buffer->buffer();
+	allocation.offset = _frame * _frameSize + offset;
+	allocation.size = size;
+	allocation.cpu = static_cast<char*>(_buffer->mapped()) + allocation.offset;
+	return allocation;
+}
+
+void JFrameAllocator::flush()
+{
+	if (_head > 0) {
+		_buffer->flush(_frame * _frameSize, _head);
+	}
+}
+
+VkDescriptorBufferInfo JFrameAllocator::descriptorInfo(VkDeviceSize range) const
+{
+	VkDescriptorBufferInfo info{};
+	info.buffer = buffer();
+	info.offset = 0; // the dynamic offset is added to this when binding
+	info.range = range;
+	return info;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstring>
+
+#include "JDevice.h"
+#include "JBuffer.h"
+
+// a piece of the current frame's memory
+// bind buffer at offset (or use offset as a dynamic offset), write through cpu
+struct JFrameAllocation {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0; // from the start of buffer, not the frame
+	VkDeviceSize size = 0;
+	void* cpu = nullptr;
+
+	template<typename T>
+	inline T* as() const { return static_cast<T*>(cpu); }
+};
+
+// linear (bump) allocator for data that only lives for one frame: uniforms, instance data,
+// dynamic vertices, debug lines...
+// one persistently mapped buffer, split into a region per frame in flight
+// beginFrame(frame) throws away everything allocated the last time frame's region was used, so only call
+// it once that frame's fence has signalled
+// allocating is just bumping an offset, there are no driver calls until flush()
+// everything comes from the same buffer, so one descriptor set with dynamic offsets covers it all
+class JFrameAllocator
+{
+protected:
+	const JDevice* _pDevice;
+	JBuffer* _buffer = nullptr;
+
+	VkDeviceSize _uniformAlignment; // minUniformBufferOffsetAlignment
+	VkDeviceSize _storageAlignment; // minStorageBufferOffsetAlignment
+	VkDeviceSize _frameSize; // size of each frame's region
+	uint32_t _frameCount;
+
+	uint32_t _frame = 0; // region currently being allocated from
+	VkDeviceSize _head = 0; // next free byte in the current region
+	VkDeviceSize _peak = 0; // most any frame has used, for sizing the regions
+
+public:
+	JFrameAllocator() = delete;
+	JFrameAllocator(const JFrameAllocator&) = delete;
+	void operator=(const JFrameAllocator&) = delete;
+
+	JFrameAllocator(const JDevice* device, VkDeviceSize frameSize, uint32_t frameCount,
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	virtual ~JFrameAllocator();
+
+	inline VkBuffer buffer() const { return _buffer->buffer(); }
+	inline VkDeviceSize uniformAlignment() const { return _uniformAlignment; }
+	inline VkDeviceSize storageAlignment() const { return _storageAlignment; }
+	inline VkDeviceSize frameSize() const { return _frameSize; }
+	inline uint32_t frameCount() const { return _frameCount; }
+	inline VkDeviceSize used() const { return _head; }
+	inline VkDeviceSize peakUsed() const { return _peak; }
+
+	// starts allocating from frame's region
+	void beginFrame(uint32_t frame);
+
+	// size bytes from the current frame, alignment has to be a power of 2
+	// throws if the frame is out of space
+	JFrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+	inline JFrameAllocation allocateUniform(VkDeviceSize size) { return allocate(size, _uniformAlignment); }
+	inline JFrameAllocation allocateStorage(VkDeviceSize size) { return allocate(size, _storageAlignment); }
+
+	// copies value/values into the current frame
+	template<typename T>
+	inline JFrameAllocation push(const T& value, VkDeviceSize alignment = 16) {
+		JFrameAllocation allocation = allocate(sizeof(T), alignment);
+		memcpy(allocation.cpu, &value, sizeof(T));
+		return allocation;
+	}
+	template<typename T>
+	inline JFrameAllocation push(const std::vector<T>& values, VkDeviceSize alignment = 16) {
+		JFrameAllocation allocation = allocate(sizeof(T) * values.size(), alignment);
+		memcpy(allocation.cpu, values.data(), sizeof(T) * values.size());
+		return allocation;
+	}
+	template<typename T>
+	inline JFrameAllocation pushUniform(const T& value) { return push(value, _uniformAlignment); }
+
+	// makes everything written this frame visible to the GPU, call before submitting
+	// (a no-op on coherent memory)
+	void flush();
+
+	// descriptor info for a range bytes window of the buffer, the dynamic offset moves it
+	VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+};
+
@@ -2,9 +2,11 @@
 
 #include <stb_image.h>
 #include <stdexcept>
+#include <cstring>
 #include "JBuffer.h"
 #include "vkutils.h"
 #include "JCommandBuffer.h"
+#include "JUploadManager.h"
 
 
 
@@ -23,7 +25,7 @@ JImage::JImage(
 	// _physical(physical)
 	//, _device(device)
 	, _image(VK_NULL_HANDLE)
-	, _memory(VK_NULL_HANDLE)
+	, _allocation{}
 	, _format(format)
 	, _tiling(tiling)
 	, _usage(usage)
@@ -32,17 +34,8 @@ JImage::JImage(
 {
 	// "textures/stones-1000x1000.jpg"
 
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(fname.c_str(), &texWidth, &texHeight, &texChannels,
-		STBI_rgb_alpha); // the STBI_rgb_alpha forces loading with an alpha channel
-	VkDeviceSize imageSize = (uint64_t)texWidth * texHeight * 4;
-
-	if (!pixels) {
-		throw std::runtime_error("failed to load texture image!" + fname);
-	}
-
-	_width = static_cast<uint32_t>(texWidth);
-	_height = static_cast<uint32_t>(texHeight);
+	VkDeviceSize imageSize;
+	stbi_uc* pixels = loadFile(fname, &imageSize);
 
 	JBuffer stagingBuffer(
 		//_physical,
@@ -51,10 +44,7 @@ JImage::JImage(
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	void* data;
-	vkMapMemory(_pDevice->device(), stagingBuffer.memory(), 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device->device(), stagingBuffer.memory());
+	stagingBuffer.write(pixels, imageSize);
 
 	stbi_image_free(pixels); // clean up pixel array
 
@@ -69,6 +59,35 @@ JImage::JImage(
 	// todo: consider moving image loading code elsewhere
 }
 
+JImage::JImage(
+	const JDevice* device,
+	JUploadManager* uploads,
+	std::string fname,
+	VkFormat format,
+	VkImageTiling tiling,
+	VkImageUsageFlags usage,
+	VkMemoryPropertyFlags properties)
+	: _pDevice(device)
+	, _pool(uploads->pool())
+	, _image(VK_NULL_HANDLE)
+	, _allocation{}
+	, _format(format)
+	, _tiling(tiling)
+	, _usage(usage)
+	, _properties(properties)
+	, _filename(fname)
+{
+	VkDeviceSize imageSize;
+	stbi_uc* pixels = loadFile(fname, &imageSize);
+
+	initializeImage();
+
+	// copied into the upload manager's staging memory straight away, so the pixels can go
+	uploads->upload(this, pixels, imageSize);
+
+	stbi_image_free(pixels);
+}
+
 JImage::JImage(
 	//VkPhysicalDevice physical,
 	//VkDevice device,
@@ -85,7 +104,7 @@ JImage::JImage(
 	// _physical(physical)
 	//, _device(device)
 	, _image(VK_NULL_HANDLE)
-	, _memory(VK_NULL_HANDLE)
+	, _allocation{}
 	, _format(format)
 	, _tiling(tiling)
 	, _usage(usage)
@@ -97,10 +116,74 @@ JImage::JImage(
 	initializeImage();
 }
 
+unsigned char* JImage::loadFile(const std::string& fname, VkDeviceSize* imageSize)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(fname.c_str(), &texWidth, &texHeight, &texChannels,
+		STBI_rgb_alpha); // the STBI_rgb_alpha forces loading with an alpha channel
+
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image!" + fname);
+	}
+
+	_width = static_cast<uint32_t>(texWidth);
+	_height = static_cast<uint32_t>(texHeight);
+	*imageSize = (uint64_t)texWidth * texHeight * 4;
+	return pixels;
+}
+
+JImage::JImage(JImage&& other) noexcept
+	: _image(other._image)
+	, _allocation(other._allocation)
+	, _width(other._width)
+	, _height(other._height)
+	, _pDevice(other._pDevice)
+	, _pool(other._pool)
+	, _layout(other._layout)
+	, _format(other._format)
+	, _tiling(other._tiling)
+	, _usage(other._usage)
+	, _properties(other._properties)
+	, _filename(std::move(other._filename))
+{
+	other._image = VK_NULL_HANDLE;
+	other._allocation = JAllocation{};
+}
+
+JImage& JImage::operator=(JImage&& other) noexcept
+{
+	if (this != &other) {
+		destroy();
+		_image = other._image;
+		_allocation = other._allocation;
+		_width = other._width;
+		_height = other._height;
+		_pDevice = other._pDevice;
+		_pool = other._pool;
+		_layout = other._layout;
+		_format = other._format;
+		_tiling = other._tiling;
+		_usage = other._usage;
+		_properties = other._properties;
+		_filename = std::move(other._filename);
+		other._image = VK_NULL_HANDLE;
+		other._allocation = JAllocation{};
+	}
+	return *this;
+}
+
 JImage::~JImage()
 {
-	vkDestroyImage(_pDevice->device(), _image, nullptr);
-	vkFreeMemory(_pDevice->device(), _memory, nullptr);
+	destroy();
+}
+
+void JImage::destroy()
+{
+	if (_image != VK_NULL_HANDLE) {
+		vkDestroyImage(_pDevice->device(), _image, nullptr);
+		_image = VK_NULL_HANDLE;
+	}
+	_pDevice->allocator()->free(_allocation); // no-op for an empty allocation
 }
 
 
@@ -145,11 +228,18 @@ void JImage::transitionImageLayout(VkFormat format, VkImageLayout newLayout)
 		}
 		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
 			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT; // sampled in the fragment shader
+		}
+		else {
+			throw std::invalid_argument("unsupported layout transition!");
 		}
 
 		vkCmdPipelineBarrier(
 			buffer.buffer(),
-			0 /*TODO*/, 0 /*TODO*/, // pipeline stage in which ops occcur that happen before the barrier
+			sourceStage, destinationStage, // pipeline stage in which ops occcur that happen before the barrier
 			// then pipeline stage in which ops will wait on the barrier
 			0, // 0 or VK_DEPENDENCY_BY_REGION_BIT, latter is a by region condition, meaning implementation
 			// can begin reading from the parts that were already written so far
@@ -176,8 +266,8 @@ void JImage::copyBufferToImage(const JBuffer* buffer)
 
 		region.imageOffset = { 0,0,0 };
 		region.imageExtent = {
-			this->width,
-			this->height,
+			this->width(),
+			this->height(),
 			1
 		};
 
@@ -229,18 +319,17 @@ void JImage::initializeImage()
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(_pDevice->device(), _image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(
-		_pDevice->physical(),
-		//_physical,
+	MemoryUsage usage = (_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? MemoryUsage::CpuToGpu : MemoryUsage::GpuOnly;
+	uint32_t memoryType = findMemoryType(
+		_pDevice->allocator()->memoryProperties(),
 		memRequirements.memoryTypeBits,
+		usage,
 		_properties);
 
-	if (vkAllocateMemory(_pDevice->device(), &allocInfo, nullptr, &_memory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory! " + _filename);
-	}
+	// optimally tiled images can't share a bufferImageGranularity page with buffers,
+	// the allocator keeps them apart
+	JAllocationKind kind = _tiling == VK_IMAGE_TILING_OPTIMAL ? JAllocationKind::JOptimal : JAllocationKind::JLinear;
+	_allocation = _pDevice->allocator()->allocate(memRequirements, memoryType, kind);
 
-	vkBindImageMemory(_pDevice->device(), _image, _memory, 0);
+	vkBindImageMemory(_pDevice->device(), _image, _allocation.memory, _allocation.offset);
 }
@@ -4,12 +4,19 @@
 #include <string>
 #include "JDevice.h"
 #include "JCommandPool.h"
+#include "JMemoryAllocator.h"
 
+class JBuffer;
+class JUploadManager;
+
+// owns a VkImage and its memory
+// movable, so images can be stored by value (the moved-from image is left empty)
 class JImage
 {
+	friend class JUploadManager; // keeps _layout up to date when it records transitions
 protected:
 	VkImage _image;
-	VkDeviceMemory _memory;
+	JAllocation _allocation;
 	uint32_t _width, _height;
 	
 	//VkPhysicalDevice _physical;
@@ -42,6 +49,17 @@ public:
 		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+	// loads the file and queues the upload on uploads, instead of waiting for the copy
+	// the image can be used by anything submitted to uploads->pool()'s queue after the upload is submitted
+	JImage(
+		const JDevice* device,
+		JUploadManager* uploads,
+		std::string fname,
+		VkFormat format = VK_FORMAT_R8G8B8A8_SRGB,
+		VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL,
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
 	JImage(
 		//VkPhysicalDevice physical,
 		//VkDevice device,
@@ -54,10 +72,17 @@ public:
 		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+	JImage(JImage&& other) noexcept;
+	JImage& operator=(JImage&& other) noexcept;
+
 	virtual ~JImage();
 
+	// false once the image has been moved from
+	inline bool valid() const { return _image != VK_NULL_HANDLE; }
+
 	inline VkImage image() const { return _image; }
-	inline VkDeviceMemory memory() const { return _memory; }
+	inline VkDeviceMemory memory() const { return _allocation.memory; }
+	inline VkDeviceSize offset() const { return _allocation.offset; } // offset of the image in memory()
 
 	inline uint32_t width() const { return _width; }
 	inline uint32_t height() const { return _height; }
@@ -72,5 +97,8 @@ public:
 
 private:
 	void initializeImage();
+	void destroy();
+	// loads fname as rgba8 and sets the size, free the result with stbi_image_free
+	unsigned char* loadFile(const std::string& fname, VkDeviceSize* imageSize);
 };
 
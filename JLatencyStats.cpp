@@ -0,0 +1,30 @@
+#include "JLatencyStats.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+double JLatencyStats::percentile(double p) const
+{
+	if (_samples.empty()) {
+		return 0.0;
+	}
+	std::vector<double> sorted = _samples;
+	size_t rank = static_cast<size_t>(std::min(std::max(p, 0.0), 1.0) * (sorted.size() - 1) + 0.5);
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+std::string JLatencyStats::toJson() const
+{
+	std::ostringstream out;
+	double maxSample = _samples.empty() ? 0.0 : *std::max_element(_samples.begin(), _samples.end());
+	out << "{\"frames\":" << count()
+		<< ",\"averageMs\":" << average() * 1000.0
+		<< ",\"p50Ms\":" << percentile(0.5) * 1000.0
+		<< ",\"p95Ms\":" << percentile(0.95) * 1000.0
+		<< ",\"p99Ms\":" << percentile(0.99) * 1000.0
+		<< ",\"maxMs\":" << maxSample * 1000.0
+		<< "}";
+	return out.str();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// latency samples, in seconds, summarised every so often and then reset
+class JLatencyStats
+{
+protected:
+	std::vector<double> _samples;
+	double _total = 0.0;
+
+public:
+	JLatencyStats() = default;
+	JLatencyStats(const JLatencyStats&) = delete;
+	void operator=(const JLatencyStats&) = delete;
+
+	inline void record(double seconds) { _samples.push_back(seconds); _total += seconds; }
+	inline void reset() { _samples.clear(); _total = 0.0; }
+
+	inline size_t count() const { return _samples.size(); }
+	inline double average() const { return _samples.empty() ? 0.0 : _total / _samples.size(); }
+	// p in [0, 1], nearest rank, 0 with no samples
+	double percentile(double p) const;
+
+	// a json object with the summary in milliseconds, for putting in a line with the settings it was measured under
+	std::string toJson() const;
+};
@@ -0,0 +1,145 @@
+#include "JLayoutCache.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+JLayoutCache::JLayoutCache(const JDevice* device)
+	: _pDevice(device)
+{
+}
+
+JLayoutCache::~JLayoutCache()
+{
+	// pipeline layouts first, they were made from the set layouts
+	for (auto& bucket : _pipelineLayouts) {
+		for (PipelineLayout& entry : bucket.second) {
+			vkDestroyPipelineLayout(_pDevice->device(), entry.layout, nullptr);
+		}
+	}
+	for (auto& bucket : _setLayouts) {
+		for (SetLayout& entry : bucket.second) {
+			vkDestroyDescriptorSetLayout(_pDevice->device(), entry.layout, nullptr);
+		}
+	}
+}
+
+static bool sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y) {
+		return x.binding == y.binding && x.descriptorType == y.descriptorType
+			&& x.descriptorCount == y.descriptorCount && x.stageFlags == y.stageFlags;
+	});
+}
+
+static bool samePushConstants(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkPushConstantRange& x, const VkPushConstantRange& y) {
+		return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+	});
+}
+
+VkDescriptorSetLayout JLayoutCache::descriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+	std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+		return a.binding < b.binding;
+	});
+
+	// field by field, the structs can have padding in them
+	uint64_t h = FNV_OFFSET_BASIS;
+	for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+		if (binding.pImmutableSamplers != nullptr) {
+			throw std::runtime_error("immutable samplers aren't supported by the layout cache!");
+		}
+		h = fnv1a(&binding.binding, sizeof(binding.binding), h);
+		h = fnv1a(&binding.descriptorType, sizeof(binding.descriptorType), h);
+		h = fnv1a(&binding.descriptorCount, sizeof(binding.descriptorCount), h);
+		h = fnv1a(&binding.stageFlags, sizeof(binding.stageFlags), h);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<SetLayout>& bucket = _setLayouts[h];
+	for (const SetLayout& entry : bucket) {
+		if (sameBindings(entry.bindings, bindings)) {
+			++_stats.hits;
+			return entry.layout;
+		}
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(_pDevice->device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+	bucket.push_back({ bindings, layout });
+	++_stats.setLayouts;
+	return layout;
+}
+
+VkPipelineLayout JLayoutCache::pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+{
+	// set layouts are already deduplicated, so the same handles means the same layouts
+	uint64_t h = FNV_OFFSET_BASIS;
+	for (const VkDescriptorSetLayout& setLayout : setLayouts) {
+		h = fnv1a(&setLayout, sizeof(setLayout), h);
+	}
+	for (const VkPushConstantRange& range : pushConstants) {
+		h = fnv1a(&range.stageFlags, sizeof(range.stageFlags), h);
+		h = fnv1a(&range.offset, sizeof(range.offset), h);
+		h = fnv1a(&range.size, sizeof(range.size), h);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<PipelineLayout>& bucket = _pipelineLayouts[h];
+	for (const PipelineLayout& entry : bucket) {
+		if (entry.setLayouts == setLayouts && samePushConstants(entry.pushConstants, pushConstants)) {
+			++_stats.hits;
+			return entry.layout;
+		}
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
+	VkPipelineLayout layout;
+	if (vkCreatePipelineLayout(_pDevice->device(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+	bucket.push_back({ setLayouts, pushConstants, layout });
+	++_stats.pipelineLayouts;
+	return layout;
+}
+
+JLayout JLayoutCache::layout(const JShaderReflection& reflection)
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets(reflection.setCount());
+	for (const JDescriptorBinding& binding : reflection.bindings) {
+		VkDescriptorSetLayoutBinding layoutBinding{};
+		layoutBinding.binding = binding.binding;
+		layoutBinding.descriptorType = binding.type;
+		layoutBinding.descriptorCount = binding.count;
+		layoutBinding.stageFlags = binding.stages;
+		layoutBinding.pImmutableSamplers = nullptr;
+		sets[binding.set].push_back(layoutBinding);
+	}
+
+	JLayout layout;
+	for (const auto& bindings : sets) {
+		layout.setLayouts.push_back(descriptorSetLayout(bindings));
+	}
+	layout.pipelineLayout = pipelineLayout(layout.setLayouts, reflection.pushConstants);
+	return layout;
+}
+
+JLayoutCacheStats JLayoutCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "JDevice.h"
+#include "JShaderReflection.h"
+
+// the layouts for one JShaderReflection
+struct JLayout {
+	std::vector<VkDescriptorSetLayout> setLayouts; // one per set, sets nothing uses get an empty layout
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+};
+
+struct JLayoutCacheStats {
+	uint32_t setLayouts = 0; // created
+	uint32_t pipelineLayouts = 0;
+	uint32_t hits = 0; // asked for one that already existed
+};
+
+// descriptor set and pipeline layouts by their contents, so asking twice for the same one gives back the
+// same handle, pipelines made from shaders that agree on their bindings share layouts, and sets bound for
+// one of them stay bound for the next
+// owns the layouts, thread safe
+class JLayoutCache
+{
+protected:
+	struct SetLayout {
+		std::vector<VkDescriptorSetLayoutBinding> bindings; // sorted by binding, no immutable samplers
+		VkDescriptorSetLayout layout;
+	};
+	struct PipelineLayout {
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		std::vector<VkPushConstantRange> pushConstants;
+		VkPipelineLayout layout;
+	};
+
+	const JDevice* _pDevice;
+
+	mutable std::mutex _mutex;
+	// by hash, a hash can have more than one layout if it collides
+	std::unordered_map<uint64_t, std::vector<SetLayout>> _setLayouts;
+	std::unordered_map<uint64_t, std::vector<PipelineLayout>> _pipelineLayouts;
+	JLayoutCacheStats _stats;
+
+public:
+	JLayoutCache() = delete;
+	JLayoutCache(const JLayoutCache&) = delete;
+	void operator=(const JLayoutCache&) = delete;
+
+	JLayoutCache(const JDevice* device);
+	// destroys every layout, so only once nothing that uses them is left
+	virtual ~JLayoutCache();
+
+	// the order of bindings doesn't matter
+	VkDescriptorSetLayout descriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+	VkPipelineLayout pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+	// every set layout reflection's bindings need, and the pipeline layout with them and its push constants
+	JLayout layout(const JShaderReflection& reflection);
+
+	JLayoutCacheStats stats() const;
+};
@@ -0,0 +1,113 @@
+#include "JMappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+JMappedFile::JMappedFile(const std::string& filename)
+	: _filename(filename)
+{
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open file!");
+	}
+	_file = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size)) {
+		close();
+		throw std::runtime_error("failed to get file size!");
+	}
+	_size = static_cast<size_t>(size.QuadPart);
+	if (_size == 0) {
+		return; // windows won't map an empty file
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+	_mapping = mapping;
+
+	_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (_data == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+}
+
+void JMappedFile::close()
+{
+	if (_data != nullptr) {
+		UnmapViewOfFile(_data);
+		_data = nullptr;
+	}
+	if (_mapping != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_mapping));
+		_mapping = nullptr;
+	}
+	if (_file != nullptr) {
+		CloseHandle(static_cast<HANDLE>(_file));
+		_file = nullptr;
+	}
+}
+
+#else
+
+JMappedFile::JMappedFile(const std::string& filename)
+	: _filename(filename)
+{
+	_fd = ::open(filename.c_str(), O_RDONLY);
+	if (_fd < 0) {
+		throw std::runtime_error("failed to open file!");
+	}
+
+	struct stat info{};
+	if (fstat(_fd, &info) != 0) {
+		close();
+		throw std::runtime_error("failed to get file size!");
+	}
+	_size = static_cast<size_t>(info.st_size);
+	if (_size == 0) {
+		return; // mmap won't take a length of 0
+	}
+
+	void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (data == MAP_FAILED) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+	_data = static_cast<const uint8_t*>(data);
+}
+
+void JMappedFile::close()
+{
+	if (_data != nullptr) {
+		munmap(const_cast<uint8_t*>(_data), _size);
+		_data = nullptr;
+	}
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+}
+
+#endif
+
+JMappedFile::~JMappedFile()
+{
+	close();
+}
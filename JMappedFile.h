@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// a whole file mapped read only into memory, so it can be handed straight to the driver without copying
+// it into a buffer first, the data is page aligned
+// unmapped in the destructor, so pointers into it don't outlive the JMappedFile
+class JMappedFile
+{
+protected:
+	std::string _filename;
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	void* _file = nullptr; // HANDLEs, windows.h stays out of the header
+	void* _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+
+	void close();
+
+public:
+	JMappedFile() = delete;
+	JMappedFile(const JMappedFile&) = delete;
+	void operator=(const JMappedFile&) = delete;
+
+	// throws if the file can't be opened or mapped, an empty file maps to nothing (data() is nullptr)
+	JMappedFile(const std::string& filename);
+	virtual ~JMappedFile();
+
+	inline const std::string& filename() const { return _filename; }
+	inline const uint8_t* data() const { return _data; }
+	inline size_t size() const { return _size; }
+};
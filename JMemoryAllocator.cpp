@@ -0,0 +1,419 @@
+#include "JMemoryAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include "JDevice.h"
+
+
+static inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) & ~(alignment - 1); // alignments are always powers of 2
+}
+
+// true if the last byte of one resource and the first byte of the next fall in the same
+// bufferImageGranularity "page"
+static inline bool onSamePage(VkDeviceSize endOfFirst, VkDeviceSize startOfSecond, VkDeviceSize granularity) {
+	return (endOfFirst & ~(granularity - 1)) == (startOfSecond & ~(granularity - 1));
+}
+
+
+JMemoryBlock::JMemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, void* mapped)
+	: _memory(memory)
+	, _size(size)
+	, _memoryType(memoryType)
+	, _mapped(mapped)
+{
+	// starts out as one big free range
+	_ranges[0] = Range{ size, true, JAllocationKind::JLinear };
+	_freeBySize.insert(std::make_pair(size, (VkDeviceSize)0));
+}
+
+void JMemoryBlock::insertFree(VkDeviceSize offset, VkDeviceSize size)
+{
+	_ranges[offset] = Range{ size, true, JAllocationKind::JLinear };
+	_freeBySize.insert(std::make_pair(size, offset));
+}
+
+void JMemoryBlock::eraseFree(VkDeviceSize offset, VkDeviceSize size)
+{
+	auto candidates = _freeBySize.equal_range(size);
+	for (auto it = candidates.first; it != candidates.second; ++it) {
+		if (it->second == offset) {
+			_freeBySize.erase(it);
+			return;
+		}
+	}
+}
+
+bool JMemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, JAllocationKind kind, VkDeviceSize granularity, VkDeviceSize* offset)
+{
+	// walk the free ranges from the smallest one that could fit, the first that actually fits
+	// once alignment and granularity are accounted for is the best fit
+	for (auto it = _freeBySize.lower_bound(size); it != _freeBySize.end(); ++it) {
+		VkDeviceSize rangeSize = it->first;
+		VkDeviceSize rangeOffset = it->second;
+		auto range = _ranges.find(rangeOffset);
+
+		VkDeviceSize candidate = alignUp(rangeOffset, alignment);
+
+		// free ranges are always merged, so any neighbour is in use
+		if (granularity > 1 && range != _ranges.begin()) {
+			auto prev = std::prev(range);
+			if (prev->second.kind != kind && onSamePage(prev->first + prev->second.size - 1, candidate, granularity)) {
+				candidate = alignUp(candidate, granularity);
+			}
+		}
+		if (candidate + size > rangeOffset + rangeSize) {
+			continue;
+		}
+		auto next = std::next(range);
+		if (granularity > 1 && next != _ranges.end()
+			&& next->second.kind != kind && onSamePage(candidate + size - 1, next->first, granularity)) {
+			continue;
+		}
+
+		// found it, split the free range into [padding][allocation][tail]
+		_freeBySize.erase(it);
+		_ranges.erase(range);
+
+		if (candidate > rangeOffset) {
+			insertFree(rangeOffset, candidate - rangeOffset);
+		}
+		_ranges[candidate] = Range{ size, false, kind };
+		VkDeviceSize tail = rangeOffset + rangeSize - (candidate + size);
+		if (tail > 0) {
+			insertFree(candidate + size, tail);
+		}
+
+		_used += size;
+		++_allocationCount;
+		*offset = candidate;
+		return true;
+	}
+	return false;
+}
+
+void JMemoryBlock::free(VkDeviceSize offset)
+{
+	auto range = _ranges.find(offset);
+	if (range == _ranges.end() || range->second.free) {
+		throw std::runtime_error("freeing memory that was not allocated from this block!");
+	}
+
+	_used -= range->second.size;
+	--_allocationCount;
+
+	VkDeviceSize freeOffset = range->first;
+	VkDeviceSize freeSize = range->second.size;
+
+	// merge with free neighbours
+	auto next = std::next(range);
+	if (next != _ranges.end() && next->second.free) {
+		freeSize += next->second.size;
+		eraseFree(next->first, next->second.size);
+		_ranges.erase(next);
+	}
+	if (range != _ranges.begin()) {
+		auto prev = std::prev(range);
+		if (prev->second.free) {
+			freeOffset = prev->first;
+			freeSize += prev->second.size;
+			eraseFree(prev->first, prev->second.size);
+			_ranges.erase(prev);
+		}
+	}
+	_ranges.erase(offset);
+	insertFree(freeOffset, freeSize);
+}
+
+VkDeviceSize JMemoryBlock::largestFreeRange() const
+{
+	if (_freeBySize.empty()) {
+		return 0;
+	}
+	return _freeBySize.rbegin()->first;
+}
+
+JMemoryAllocator::JMemoryAllocator(const JDevice* device, VkDeviceSize preferredBlockSize)
+	: _pDevice(device)
+	, _preferredBlockSize(preferredBlockSize)
+{
+	vkGetPhysicalDeviceMemoryProperties(_pDevice->physical(), &_memProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_pDevice->physical(), &properties);
+	_bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+JMemoryAllocator::~JMemoryAllocator()
+{
+	for (auto& blocks : _blocks) {
+		for (auto& block : blocks) {
+			// anything still allocated at this point is leaked by its owner, but the memory goes
+			// away with the block either way (freeing memory implicitly unmaps it)
+			vkFreeMemory(_pDevice->device(), block->memory(), nullptr);
+		}
+		blocks.clear();
+	}
+}
+
+void JMemoryAllocator::trackAllocate(uint32_t memoryType, VkDeviceSize allocated, VkDeviceSize used)
+{
+	uint32_t heap = _memProperties.memoryTypes[memoryType].heapIndex;
+	_heapAllocated[heap] += allocated;
+	_heapUsed[heap] += used;
+	_heapPeakAllocated[heap] = std::max(_heapPeakAllocated[heap], _heapAllocated[heap]);
+	_heapPeakUsed[heap] = std::max(_heapPeakUsed[heap], _heapUsed[heap]);
+}
+
+void JMemoryAllocator::trackFree(uint32_t memoryType, VkDeviceSize allocated, VkDeviceSize used)
+{
+	uint32_t heap = _memProperties.memoryTypes[memoryType].heapIndex;
+	_heapAllocated[heap] -= allocated;
+	_heapUsed[heap] -= used;
+}
+
+// small heaps (e.g. the 256MB device local + host visible heap) get smaller blocks so
+// one block can't eat the whole heap
+VkDeviceSize JMemoryAllocator::blockSizeFor(uint32_t memoryType) const
+{
+	VkDeviceSize heapSize = _memProperties.memoryHeaps[_memProperties.memoryTypes[memoryType].heapIndex].size;
+	return std::min(_preferredBlockSize, alignUp(heapSize / 8, 1024 * 1024));
+}
+
+VkDeviceMemory JMemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(_pDevice->device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	// map host visible memory once, up front, and leave it mapped until it's freed
+	*mapped = nullptr;
+	if (_memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(_pDevice->device(), memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			vkFreeMemory(_pDevice->device(), memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+	return memory;
+}
+
+JAllocation JMemoryAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memoryType, JAllocationKind kind)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	JAllocation allocation{};
+	allocation.memoryType = memoryType;
+
+	VkDeviceSize size = requirements.size;
+	VkDeviceSize alignment = requirements.alignment;
+	// non-coherent allocations are padded out to whole atoms, so flushing one never touches
+	// the bytes of a neighbour
+	if (!isCoherent(memoryType)) {
+		alignment = std::max(alignment, _nonCoherentAtomSize);
+		size = alignUp(size, _nonCoherentAtomSize);
+	}
+	allocation.size = size;
+
+	VkDeviceSize blockSize = blockSizeFor(memoryType);
+
+	// big resources get their own allocation, they'd just fragment the blocks
+	if (size > blockSize / 2) {
+		allocation.memory = allocateMemory(size, memoryType, &allocation.mapped);
+		allocation.offset = 0;
+		allocation.block = nullptr;
+		++_dedicatedCount[memoryType];
+		_dedicatedBytes[memoryType] += size;
+		trackAllocate(memoryType, size, size);
+		return allocation;
+	}
+
+	JMemoryBlock* block = nullptr;
+	for (auto& candidate : _blocks[memoryType]) {
+		if (candidate->allocate(size, alignment, kind, _bufferImageGranularity, &allocation.offset)) {
+			block = candidate.get();
+			break;
+		}
+	}
+
+	if (block == nullptr) {
+		// nothing fits, start a new block
+		void* mapped;
+		VkDeviceMemory memory = allocateMemory(blockSize, memoryType, &mapped);
+		_blocks[memoryType].push_back(std::make_unique<JMemoryBlock>(memory, blockSize, memoryType, mapped));
+		block = _blocks[memoryType].back().get();
+		trackAllocate(memoryType, blockSize, 0);
+		if (!block->allocate(size, alignment, kind, _bufferImageGranularity, &allocation.offset)) {
+			throw std::runtime_error("failed to allocate from a new memory block!");
+		}
+	}
+	trackAllocate(memoryType, 0, size);
+
+	allocation.memory = block->memory();
+	allocation.block = block;
+	if (block->mapped() != nullptr) {
+		allocation.mapped = static_cast<char*>(block->mapped()) + allocation.offset;
+	}
+	return allocation;
+}
+
+void JMemoryAllocator::free(JAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (allocation.block == nullptr) {
+		vkFreeMemory(_pDevice->device(), allocation.memory, nullptr);
+		--_dedicatedCount[allocation.memoryType];
+		_dedicatedBytes[allocation.memoryType] -= allocation.size;
+		trackFree(allocation.memoryType, allocation.size, allocation.size);
+	}
+	else {
+		JMemoryBlock* block = allocation.block;
+		block->free(allocation.offset);
+		trackFree(allocation.memoryType, 0, allocation.size);
+
+		// give empty blocks back to the driver, but keep one around per memory type so
+		// a create/destroy loop doesn't allocate a block every time
+		if (block->empty()) {
+			auto& blocks = _blocks[block->memoryType()];
+			size_t emptyCount = std::count_if(blocks.begin(), blocks.end(),
+				[](const std::unique_ptr<JMemoryBlock>& b) { return b->empty(); });
+			if (emptyCount > 1) {
+				trackFree(block->memoryType(), block->size(), 0);
+				vkFreeMemory(_pDevice->device(), block->memory(), nullptr);
+				blocks.erase(std::find_if(blocks.begin(), blocks.end(),
+					[block](const std::unique_ptr<JMemoryBlock>& b) { return b.get() == block; }));
+			}
+		}
+	}
+	allocation = JAllocation{};
+}
+
+VkMappedMemoryRange JMemoryAllocator::alignedRange(const JAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+	if (size == VK_WHOLE_SIZE) {
+		size = allocation.size - offset;
+	}
+	VkDeviceSize memorySize = allocation.block ? allocation.block->size() : allocation.size;
+
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = begin + size;
+	begin = begin & ~(_nonCoherentAtomSize - 1);
+	end = alignUp(end, _nonCoherentAtomSize);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = begin;
+	// the end of the memory doesn't have to be a multiple of the atom size, so
+	// the range has to stop at the end exactly (or be WHOLE_SIZE)
+	range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+	return range;
+}
+
+void JMemoryAllocator::flush(const JAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isCoherent(allocation.memoryType)) {
+		return;
+	}
+	VkMappedMemoryRange range = alignedRange(allocation, offset, size);
+	if (vkFlushMappedMemoryRanges(_pDevice->device(), 1, &range) != VK_SUCCESS) {
+		throw std::runtime_error("failed to flush mapped memory!");
+	}
+}
+
+void JMemoryAllocator::invalidate(const JAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isCoherent(allocation.memoryType)) {
+		return;
+	}
+	VkMappedMemoryRange range = alignedRange(allocation, offset, size);
+	if (vkInvalidateMappedMemoryRanges(_pDevice->device(), 1, &range) != VK_SUCCESS) {
+		throw std::runtime_error("failed to invalidate mapped memory!");
+	}
+}
+
+JMemoryStats JMemoryAllocator::stats() const
+{
+	JMemoryStats stats;
+	stats.types.resize(_memProperties.memoryTypeCount);
+	stats.heaps.resize(_memProperties.memoryHeapCount);
+
+	VkDeviceSize totalFree = 0;
+	VkDeviceSize totalLargestFree = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (uint32_t i = 0; i < _memProperties.memoryTypeCount; ++i) {
+			JMemoryTypeStats& type = stats.types[i];
+			type.heapIndex = _memProperties.memoryTypes[i].heapIndex;
+			type.flags = _memProperties.memoryTypes[i].propertyFlags;
+
+			VkDeviceSize largestFreeSum = 0; // sum of every block's largest free range
+			for (const auto& block : _blocks[i]) {
+				++type.blockCount;
+				type.allocationCount += block->allocationCount();
+				type.allocatedBytes += block->size();
+				type.usedBytes += block->used();
+				type.freeBytes += block->size() - block->used();
+				VkDeviceSize largest = block->largestFreeRange();
+				type.largestFreeRange = std::max(type.largestFreeRange, largest);
+				largestFreeSum += largest;
+			}
+			type.dedicatedCount = _dedicatedCount[i];
+			type.allocationCount += _dedicatedCount[i];
+			type.allocatedBytes += _dedicatedBytes[i];
+			type.usedBytes += _dedicatedBytes[i];
+			if (type.freeBytes > 0) {
+				type.fragmentation = 1.0f - static_cast<float>(largestFreeSum) / type.freeBytes;
+			}
+			totalFree += type.freeBytes;
+			totalLargestFree += largestFreeSum;
+
+			stats.heaps[type.heapIndex].allocationCount += type.allocationCount;
+			stats.allocationCount += type.allocationCount;
+			stats.allocatedBytes += type.allocatedBytes;
+			stats.usedBytes += type.usedBytes;
+		}
+
+		for (uint32_t i = 0; i < _memProperties.memoryHeapCount; ++i) {
+			JMemoryHeapStats& heap = stats.heaps[i];
+			heap.size = _memProperties.memoryHeaps[i].size;
+			heap.flags = _memProperties.memoryHeaps[i].flags;
+			heap.allocatedBytes = _heapAllocated[i];
+			heap.usedBytes = _heapUsed[i];
+			heap.peakAllocatedBytes = _heapPeakAllocated[i];
+			heap.peakUsedBytes = _heapPeakUsed[i];
+		}
+	}
+	if (totalFree > 0) {
+		stats.fragmentation = 1.0f - static_cast<float>(totalLargestFree) / totalFree;
+	}
+
+	// the budget changes all the time (other processes, the OS), so it's queried fresh every time
+	if (_pDevice->hasMemoryBudget()) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(_pDevice->physical(), &properties);
+
+		stats.hasBudget = true;
+		for (uint32_t i = 0; i < _memProperties.memoryHeapCount; ++i) {
+			stats.heaps[i].budget = budget.heapBudget[i];
+			stats.heaps[i].usage = budget.heapUsage[i];
+		}
+	}
+	return stats;
+}
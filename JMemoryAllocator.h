@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "JMemoryStats.h"
+
+class JDevice;
+
+// buffers and linearly tiled images are "linear", optimally tiled images are not
+// linear and non-linear resources that share a VkDeviceMemory have to be at least
+// bufferImageGranularity apart, so the allocator needs to know which one it's placing
+enum class JAllocationKind {
+	JLinear, JOptimal
+};
+
+class JMemoryBlock;
+
+// a range of device memory handed out by a JMemoryAllocator
+// resources bind to memory at offset
+struct JAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	JMemoryBlock* block = nullptr; // nullptr means the allocation owns memory (dedicated)
+	void* mapped = nullptr; // start of the allocation in host memory, host visible types are always mapped
+};
+
+// one large VkDeviceMemory of a single memory type, sub-allocated with a best fit free list
+class JMemoryBlock
+{
+protected:
+	struct Range {
+		VkDeviceSize size;
+		bool free;
+		JAllocationKind kind;
+	};
+
+	VkDeviceMemory _memory = VK_NULL_HANDLE;
+	VkDeviceSize _size = 0;
+	uint32_t _memoryType = 0;
+
+	// every byte of the block is covered by exactly one range, keyed by offset
+	// neighbouring free ranges are always merged
+	std::map<VkDeviceSize, Range> _ranges;
+	// free ranges keyed by size, for best fit lookup
+	std::multimap<VkDeviceSize, VkDeviceSize> _freeBySize;
+
+	VkDeviceSize _used = 0;
+	uint32_t _allocationCount = 0;
+
+	// host visible blocks stay mapped for their whole life, mapping is a driver round trip
+	// and a VkDeviceMemory can only be mapped once anyway
+	void* _mapped = nullptr;
+
+	void insertFree(VkDeviceSize offset, VkDeviceSize size);
+	void eraseFree(VkDeviceSize offset, VkDeviceSize size);
+
+public:
+	JMemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, void* mapped);
+
+	JMemoryBlock() = delete;
+	JMemoryBlock(const JMemoryBlock&) = delete;
+	void operator=(const JMemoryBlock&) = delete;
+
+	inline VkDeviceMemory memory() const { return _memory; }
+	inline VkDeviceSize size() const { return _size; }
+	inline uint32_t memoryType() const { return _memoryType; }
+	inline VkDeviceSize used() const { return _used; }
+	inline uint32_t allocationCount() const { return _allocationCount; }
+	inline bool empty() const { return _allocationCount == 0; }
+	inline void* mapped() const { return _mapped; }
+
+	// returns false if there isn't a free range that fits
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, JAllocationKind kind, VkDeviceSize granularity, VkDeviceSize* offset);
+	void free(VkDeviceSize offset);
+
+	// size of the largest free range, used to judge fragmentation
+	VkDeviceSize largestFreeRange() const;
+};
+
+// hands out ranges of a few large VkDeviceMemory blocks per memory type instead of
+// calling vkAllocateMemory for every resource
+// (there's a limit of maxMemoryAllocationCount allocations, and allocating is slow)
+class JMemoryAllocator
+{
+protected:
+	const JDevice* _pDevice;
+
+	VkPhysicalDeviceMemoryProperties _memProperties{};
+	VkDeviceSize _bufferImageGranularity = 1;
+	VkDeviceSize _nonCoherentAtomSize = 1;
+	VkDeviceSize _preferredBlockSize;
+
+	// blocks for each memory type
+	std::vector<std::unique_ptr<JMemoryBlock>> _blocks[VK_MAX_MEMORY_TYPES];
+
+	// running totals for stats(), peaks can't be worked out after the fact
+	VkDeviceSize _heapAllocated[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize _heapUsed[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize _heapPeakAllocated[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize _heapPeakUsed[VK_MAX_MEMORY_HEAPS] = {};
+	uint32_t _dedicatedCount[VK_MAX_MEMORY_TYPES] = {};
+	VkDeviceSize _dedicatedBytes[VK_MAX_MEMORY_TYPES] = {};
+
+	mutable std::mutex _mutex;
+
+	// allocated is memory taken from/given back to the driver, used is memory handed out to/back from resources
+	void trackAllocate(uint32_t memoryType, VkDeviceSize allocated, VkDeviceSize used);
+	void trackFree(uint32_t memoryType, VkDeviceSize allocated, VkDeviceSize used);
+	VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+	// expands [offset, offset + size) of the allocation to nonCoherentAtomSize boundaries
+	VkMappedMemoryRange alignedRange(const JAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+public:
+	JMemoryAllocator(const JDevice* device, VkDeviceSize preferredBlockSize = 64 * 1024 * 1024);
+
+	JMemoryAllocator() = delete;
+	JMemoryAllocator(const JMemoryAllocator&) = delete;
+	void operator=(const JMemoryAllocator&) = delete;
+
+	~JMemoryAllocator();
+
+	inline const VkPhysicalDeviceMemoryProperties& memoryProperties() const { return _memProperties; }
+	inline VkDeviceSize nonCoherentAtomSize() const { return _nonCoherentAtomSize; }
+	// true if CPU writes don't need flushing (memory that isn't host visible can't be written anyway)
+	inline bool isCoherent(uint32_t memoryType) const {
+		VkMemoryPropertyFlags flags = _memProperties.memoryTypes[memoryType].propertyFlags;
+		return !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	JAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryType, JAllocationKind kind);
+	void free(JAllocation& allocation);
+
+	// make CPU writes to [offset, offset + size) of the allocation visible to the GPU, and GPU writes
+	// visible to the CPU respectively
+	// no-ops for HOST_COHERENT memory
+	void flush(const JAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void invalidate(const JAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	// counts, bytes and fragmentation per memory type and heap, plus the driver's budget if the
+	// device has VK_EXT_memory_budget
+	// walks every block, fine to call every few seconds but not per allocation
+	JMemoryStats stats() const;
+};
+
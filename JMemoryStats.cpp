@@ -0,0 +1,69 @@
+#include "JMemoryStats.h"
+
+#include <sstream>
+
+
+bool JMemoryStats::overBudget() const
+{
+	if (!hasBudget) {
+		return false;
+	}
+	for (const auto& heap : heaps) {
+		if (heap.usage > heap.budget) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string JMemoryStats::toJson(double timestamp) const
+{
+	std::ostringstream out;
+	out << "{";
+	if (timestamp >= 0.0) {
+		out << "\"time\":" << timestamp << ",";
+	}
+	out << "\"allocationCount\":" << allocationCount
+		<< ",\"allocatedBytes\":" << allocatedBytes
+		<< ",\"usedBytes\":" << usedBytes
+		<< ",\"fragmentation\":" << fragmentation
+		<< ",\"hasBudget\":" << (hasBudget ? "true" : "false");
+
+	out << ",\"heaps\":[";
+	for (size_t i = 0; i < heaps.size(); ++i) {
+		const JMemoryHeapStats& heap = heaps[i];
+		out << (i ? "," : "") << "{"
+			<< "\"size\":" << heap.size
+			<< ",\"deviceLocal\":" << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+			<< ",\"allocationCount\":" << heap.allocationCount
+			<< ",\"allocatedBytes\":" << heap.allocatedBytes
+			<< ",\"usedBytes\":" << heap.usedBytes
+			<< ",\"peakAllocatedBytes\":" << heap.peakAllocatedBytes
+			<< ",\"peakUsedBytes\":" << heap.peakUsedBytes;
+		if (hasBudget) {
+			out << ",\"budget\":" << heap.budget
+				<< ",\"usage\":" << heap.usage;
+		}
+		out << "}";
+	}
+	out << "]";
+
+	out << ",\"types\":[";
+	for (size_t i = 0; i < types.size(); ++i) {
+		const JMemoryTypeStats& type = types[i];
+		out << (i ? "," : "") << "{"
+			<< "\"heap\":" << type.heapIndex
+			<< ",\"flags\":" << type.flags
+			<< ",\"blockCount\":" << type.blockCount
+			<< ",\"allocationCount\":" << type.allocationCount
+			<< ",\"dedicatedCount\":" << type.dedicatedCount
+			<< ",\"allocatedBytes\":" << type.allocatedBytes
+			<< ",\"usedBytes\":" << type.usedBytes
+			<< ",\"freeBytes\":" << type.freeBytes
+			<< ",\"largestFreeRange\":" << type.largestFreeRange
+			<< ",\"fragmentation\":" << type.fragmentation
+			<< "}";
+	}
+	out << "]}";
+	return out.str();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+
+// snapshot of what a JMemoryAllocator has taken from the driver and handed out, see JMemoryAllocator::stats()
+
+struct JMemoryTypeStats {
+	uint32_t heapIndex = 0;
+	VkMemoryPropertyFlags flags = 0;
+
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0; // live allocations, including dedicated ones
+	uint32_t dedicatedCount = 0;
+	VkDeviceSize allocatedBytes = 0; // taken from the driver (blocks + dedicated allocations)
+	VkDeviceSize usedBytes = 0; // handed out to resources
+	VkDeviceSize freeBytes = 0; // free space inside blocks
+	VkDeviceSize largestFreeRange = 0;
+	// share of the free space that isn't in its block's largest free range
+	// 0 when each block's free space is in one piece, close to 1 when it's in lots of little pieces
+	float fragmentation = 0.0f;
+};
+
+struct JMemoryHeapStats {
+	VkDeviceSize size = 0;
+	VkMemoryHeapFlags flags = 0;
+
+	uint32_t allocationCount = 0;
+	VkDeviceSize allocatedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize peakAllocatedBytes = 0; // highest allocatedBytes since the allocator was created
+	VkDeviceSize peakUsedBytes = 0;
+
+	// from VK_EXT_memory_budget, only valid if JMemoryStats::hasBudget
+	// these are the driver's numbers, for the whole process (and swap chain images etc), not just the allocator
+	VkDeviceSize budget = 0; // how much the process can use before things get slow or fail
+	VkDeviceSize usage = 0; // how much the process is using
+};
+
+struct JMemoryStats {
+	std::vector<JMemoryTypeStats> types;
+	std::vector<JMemoryHeapStats> heaps;
+
+	uint32_t allocationCount = 0;
+	VkDeviceSize allocatedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	float fragmentation = 0.0f; // over every block of every type
+
+	bool hasBudget = false;
+
+	// true if any heap's driver usage is over its budget
+	bool overBudget() const;
+
+	// one line of json, timestamp is written as "time" if it's not negative
+	std::string toJson(double timestamp = -1.0) const;
+};
+
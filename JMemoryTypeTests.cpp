@@ -0,0 +1,188 @@
+#include "JMemoryTypeTests.h"
+
+#include <stdexcept>
+#include <vector>
+#include <utility>
+
+
+static const VkMemoryPropertyFlags DL = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+static const VkMemoryPropertyFlags HV = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+static const VkMemoryPropertyFlags HC = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+static const VkMemoryPropertyFlags CACHED = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+static const VkMemoryPropertyFlags PROTECTED = VK_MEMORY_PROPERTY_PROTECTED_BIT;
+static const VkDeviceSize GB = 1024ull * 1024 * 1024;
+static const uint32_t ALL_TYPES = ~0u;
+
+// heaps are (size, flags), types are (flags, heap index)
+static VkPhysicalDeviceMemoryProperties makeMemoryProperties(const std::vector<std::pair<VkDeviceSize, VkMemoryHeapFlags>>& heaps,
+	const std::vector<std::pair<VkMemoryPropertyFlags, uint32_t>>& types)
+{
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	memProperties.memoryHeapCount = static_cast<uint32_t>(heaps.size());
+	for (size_t i = 0; i < heaps.size(); ++i) {
+		memProperties.memoryHeaps[i].size = heaps[i].first;
+		memProperties.memoryHeaps[i].flags = heaps[i].second;
+	}
+	memProperties.memoryTypeCount = static_cast<uint32_t>(types.size());
+	for (size_t i = 0; i < types.size(); ++i) {
+		memProperties.memoryTypes[i].propertyFlags = types[i].first;
+		memProperties.memoryTypes[i].heapIndex = types[i].second;
+	}
+	return memProperties;
+}
+
+static const char* usageName(MemoryUsage usage)
+{
+	switch (usage) {
+	case MemoryUsage::GpuOnly: return "GpuOnly";
+	case MemoryUsage::CpuToGpu: return "CpuToGpu";
+	case MemoryUsage::Staging: return "Staging";
+	case MemoryUsage::Readback: return "Readback";
+	default: return "unknown";
+	}
+}
+
+JMemoryTypeTests::JMemoryTypeTests(std::ostream& out)
+	: _out(out)
+{
+}
+
+void JMemoryTypeTests::expectType(const std::string& name, const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	MemoryUsage usage, VkMemoryPropertyFlags properties, uint32_t expected)
+{
+	++_checks;
+	try {
+		uint32_t type = findMemoryType(memProperties, typeFilter, usage, properties);
+		if (type != expected) {
+			++_failures;
+			_out << "FAILED " << name << ": " << usageName(usage) << " got type " << type << ", expected " << expected << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		++_failures;
+		_out << "FAILED " << name << ": " << usageName(usage) << " threw (" << e.what() << "), expected type " << expected << std::endl;
+	}
+}
+
+void JMemoryTypeTests::expectNone(const std::string& name, const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	MemoryUsage usage, VkMemoryPropertyFlags properties)
+{
+	++_checks;
+	try {
+		uint32_t type = findMemoryType(memProperties, typeFilter, usage, properties);
+		++_failures;
+		_out << "FAILED " << name << ": " << usageName(usage) << " got type " << type << ", expected it to throw" << std::endl;
+	}
+	catch (const std::runtime_error&) {
+		// no type has every property that was asked for
+	}
+}
+
+void JMemoryTypeTests::expectUsage(const std::string& name, VkMemoryPropertyFlags properties, VkBufferUsageFlags bufferUsage, MemoryUsage expected)
+{
+	++_checks;
+	MemoryUsage usage = memoryUsageFor(properties, bufferUsage);
+	if (usage != expected) {
+		++_failures;
+		_out << "FAILED " << name << ": got " << usageName(usage) << ", expected " << usageName(expected) << std::endl;
+	}
+}
+
+void JMemoryTypeTests::testDiscreteSmallBar()
+{
+	// vram, system memory, and the 256MB window of vram the CPU can see
+	VkPhysicalDeviceMemoryProperties memProperties = makeMemoryProperties(
+		{ { 8 * GB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT }, { 16 * GB, 0 }, { 256 * 1024 * 1024, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT } },
+		{ { DL, 0 }, { HV | HC, 1 }, { HV | HC | CACHED, 1 }, { DL | HV | HC, 2 }, { DL | PROTECTED, 0 } });
+	const uint32_t systemOnly = (1 << 1) | (1 << 2);
+
+	expectType("discrete vertex buffer", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, DL, 0);
+	expectType("discrete gpu only, nothing asked for", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, 0, 0);
+	expectType("discrete protected", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, DL | PROTECTED, 4);
+	expectType("discrete gpu only, no vram allowed", memProperties, systemOnly, MemoryUsage::GpuOnly, 0, 1);
+	expectNone("discrete device local, no vram allowed", memProperties, systemOnly, MemoryUsage::GpuOnly, DL);
+
+	expectType("discrete uniforms go in the BAR", memProperties, ALL_TYPES, MemoryUsage::CpuToGpu, HV | HC, 3);
+	expectType("discrete uniforms, no BAR allowed", memProperties, systemOnly, MemoryUsage::CpuToGpu, HV | HC, 1);
+
+	expectType("discrete staging stays out of the small BAR", memProperties, ALL_TYPES, MemoryUsage::Staging, HV | HC, 1);
+	expectType("discrete staging, only the BAR allowed", memProperties, 1 << 3, MemoryUsage::Staging, HV | HC, 3);
+
+	expectType("discrete readback is cached", memProperties, ALL_TYPES, MemoryUsage::Readback, HV, 2);
+	expectType("discrete coherent readback", memProperties, ALL_TYPES, MemoryUsage::Readback, HV | HC, 2);
+	expectNone("discrete cached readback, no cached type allowed", memProperties, (1 << 1) | (1 << 3), MemoryUsage::Readback, HV | CACHED);
+}
+
+void JMemoryTypeTests::testDiscreteLargeBar()
+{
+	// resizable BAR, all of vram is host visible
+	VkPhysicalDeviceMemoryProperties memProperties = makeMemoryProperties(
+		{ { 16 * GB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT }, { 32 * GB, 0 } },
+		{ { DL, 0 }, { DL | HV | HC, 0 }, { HV | HC, 1 }, { HV | HC | CACHED, 1 } });
+
+	expectType("rebar vertex buffer stays out of host visible vram", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, DL, 0);
+	expectType("rebar vertex buffer, only host visible types allowed", memProperties, (1 << 1) | (1 << 2) | (1 << 3), MemoryUsage::GpuOnly, DL, 1);
+	expectType("rebar uniforms", memProperties, ALL_TYPES, MemoryUsage::CpuToGpu, HV | HC, 1);
+	expectType("rebar staging can use vram", memProperties, ALL_TYPES, MemoryUsage::Staging, HV | HC, 1);
+	expectType("rebar readback", memProperties, ALL_TYPES, MemoryUsage::Readback, HV, 3);
+}
+
+void JMemoryTypeTests::testUnified()
+{
+	// integrated graphics, one heap and everything's device local
+	VkPhysicalDeviceMemoryProperties memProperties = makeMemoryProperties(
+		{ { 16 * GB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT } },
+		{ { DL, 0 }, { DL | HV | HC, 0 }, { DL | HV | HC | CACHED, 0 } });
+
+	expectType("uma vertex buffer", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, DL, 0);
+	expectType("uma vertex buffer can be host visible", memProperties, (1 << 1) | (1 << 2), MemoryUsage::GpuOnly, DL, 1);
+	expectType("uma uniforms", memProperties, ALL_TYPES, MemoryUsage::CpuToGpu, HV | HC, 1);
+	expectType("uma staging", memProperties, ALL_TYPES, MemoryUsage::Staging, HV | HC, 1);
+	expectType("uma readback", memProperties, ALL_TYPES, MemoryUsage::Readback, HV, 2);
+
+	VkPhysicalDeviceMemoryProperties single = makeMemoryProperties(
+		{ { 8 * GB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT } },
+		{ { DL | HV | HC, 0 } });
+	expectType("uma with one type, vertex buffer", single, ALL_TYPES, MemoryUsage::GpuOnly, DL, 0);
+	expectType("uma with one type, readback", single, ALL_TYPES, MemoryUsage::Readback, HV, 0);
+}
+
+void JMemoryTypeTests::testNoCoherent()
+{
+	// the host visible memory has to be flushed by hand
+	VkPhysicalDeviceMemoryProperties memProperties = makeMemoryProperties(
+		{ { 4 * GB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT }, { 8 * GB, 0 } },
+		{ { DL, 0 }, { HV | CACHED, 1 } });
+
+	expectType("no coherent uniforms", memProperties, ALL_TYPES, MemoryUsage::CpuToGpu, HV, 1);
+	expectNone("no coherent, coherent uniforms", memProperties, ALL_TYPES, MemoryUsage::CpuToGpu, HV | HC);
+	expectType("no coherent staging", memProperties, ALL_TYPES, MemoryUsage::Staging, HV, 1);
+	expectNone("no coherent, coherent staging", memProperties, ALL_TYPES, MemoryUsage::Staging, HV | HC);
+	expectType("no coherent readback", memProperties, ALL_TYPES, MemoryUsage::Readback, HV, 1);
+	expectType("no coherent vertex buffer", memProperties, ALL_TYPES, MemoryUsage::GpuOnly, DL, 0);
+}
+
+void JMemoryTypeTests::testUsageFor()
+{
+	expectUsage("staging buffer", HV | HC, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Staging);
+	expectUsage("staging buffer copied both ways", HV | HC, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Staging);
+	expectUsage("readback buffer", HV, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback);
+	expectUsage("uniform buffer", HV | HC, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::CpuToGpu);
+	expectUsage("uniform buffer that's copied into", HV | HC, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::CpuToGpu);
+	expectUsage("host visible vertex buffer", HV | HC, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::CpuToGpu);
+	expectUsage("device local vertex buffer", DL, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly);
+	expectUsage("device local copy source", DL, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::GpuOnly);
+}
+
+uint32_t JMemoryTypeTests::run()
+{
+	_checks = 0;
+	_failures = 0;
+	testDiscreteSmallBar();
+	testDiscreteLargeBar();
+	testUnified();
+	testNoCoherent();
+	testUsageFor();
+	_out << "memory type tests: " << (_checks - _failures) << "/" << _checks << " passed" << std::endl;
+	return _failures;
+}
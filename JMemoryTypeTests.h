@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <ostream>
+#include <string>
+#include <cstdint>
+
+#include "vkutils.h"
+
+// checks the memory type policy (memoryTypePolicy, findMemoryType and memoryUsageFor in vkutils.h) against
+// made up memory layouts of the usual kinds of GPU: discrete with a small BAR, discrete with resizable BAR,
+// integrated (UMA) and one without coherent host memory
+// no device needed, run with --mode=test_memory_types
+class JMemoryTypeTests
+{
+protected:
+	std::ostream& _out;
+	uint32_t _checks = 0;
+	uint32_t _failures = 0;
+
+	void expectType(const std::string& name, const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+		MemoryUsage usage, VkMemoryPropertyFlags properties, uint32_t expected);
+	// findMemoryType has to throw, i.e. no type has every required property
+	void expectNone(const std::string& name, const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+		MemoryUsage usage, VkMemoryPropertyFlags properties);
+	void expectUsage(const std::string& name, VkMemoryPropertyFlags properties, VkBufferUsageFlags bufferUsage, MemoryUsage expected);
+
+	void testDiscreteSmallBar();
+	void testDiscreteLargeBar();
+	void testUnified();
+	void testNoCoherent();
+	void testUsageFor();
+
+public:
+	JMemoryTypeTests() = delete;
+	JMemoryTypeTests(const JMemoryTypeTests&) = delete;
+	void operator=(const JMemoryTypeTests&) = delete;
+
+	// failures are written to out, along with a summary at the end
+	JMemoryTypeTests(std::ostream& out);
+
+	// how many checks failed
+	uint32_t run();
+};
@@ -0,0 +1,83 @@
+#include "JParallelRecorder.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+JParallelRecorder::JParallelRecorder(const JDevice* device, JThreadPool* threads, uint32_t frameCount, uint32_t drawsPerChunk)
+	: _pDevice(device)
+	, _threads(threads)
+	, _frameCount(frameCount)
+	, _drawsPerChunk(std::max<uint32_t>(drawsPerChunk, 1))
+{
+	_pools.resize(static_cast<size_t>(_frameCount) * _threads->slotCount());
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		// only ever reset all together
+		_pools[i] = new JCommandPool(_pDevice, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	}
+}
+
+JParallelRecorder::~JParallelRecorder()
+{
+	for (JCommandPool* pool : _pools) {
+		delete pool;
+	}
+	_pools.clear();
+}
+
+void JParallelRecorder::reset(uint32_t frame)
+{
+	if (frame >= _frameCount) {
+		throw std::runtime_error("frame out of range for parallel recorder!");
+	}
+	for (uint32_t thread = 0; thread < _threads->slotCount(); ++thread) {
+		pool(frame, thread)->reset();
+	}
+}
+
+void JParallelRecorder::record(uint32_t frame, VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+	size_t drawCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& recordRange)
+{
+	if (frame >= _frameCount) {
+		throw std::runtime_error("frame out of range for parallel recorder!");
+	}
+	if (drawCount == 0) {
+		return;
+	}
+	uint32_t chunkCount = static_cast<uint32_t>((drawCount + _drawsPerChunk - 1) / _drawsPerChunk);
+	_secondaries.assign(chunkCount, VK_NULL_HANDLE);
+
+	// which render pass the secondaries run in, so they can be recorded before the primary gets there
+	// the framebuffer is optional, but lets the driver optimise for it
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderPass;
+	inheritance.subpass = subpass;
+	inheritance.framebuffer = framebuffer;
+
+	_threads->parallelFor(chunkCount, [this, frame, &inheritance, &recordRange, drawCount](uint32_t thread, uint32_t chunk) {
+		// this thread's pool, so no other thread is touching it
+		VkCommandBuffer buffer = pool(frame, thread)->acquire(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// RENDER_PASS_CONTINUE: the whole buffer runs inside the inherited render pass
+		// not ONE_TIME_SUBMIT, the primary might be resubmitted if nothing changes
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+		if (vkBeginCommandBuffer(buffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		size_t begin = static_cast<size_t>(chunk) * _drawsPerChunk;
+		size_t end = std::min(begin + _drawsPerChunk, drawCount);
+		recordRange(buffer, begin, end);
+
+		if (vkEndCommandBuffer(buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+		_secondaries[chunk] = buffer; // each chunk has its own slot, so no locking
+	});
+
+	vkCmdExecuteCommands(primary, chunkCount, _secondaries.data());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <functional>
+
+#include "JDevice.h"
+#include "JCommandPool.h"
+#include "JThreadPool.h"
+
+// records a render pass's draws on several threads
+// the draws are split into chunks, each chunk is recorded into a SECONDARY command buffer by whichever
+// thread picks it up, and the primary buffer runs them in order with vkCmdExecuteCommands
+// every thread has its own command pool per frame in flight, so nothing is locked while recording,
+// and the pools are reset wholesale in reset()
+// recordings stay valid until their frame is reset, so a primary buffer that executes them can be resubmitted
+class JParallelRecorder
+{
+protected:
+	const JDevice* _pDevice;
+	JThreadPool* _threads;
+	uint32_t _frameCount;
+	uint32_t _drawsPerChunk;
+
+	std::vector<JCommandPool*> _pools; // [frame * slotCount + thread]
+	std::vector<VkCommandBuffer> _secondaries; // this record()'s chunks, in draw order
+
+	inline JCommandPool* pool(uint32_t frame, uint32_t thread) const { return _pools[frame * _threads->slotCount() + thread]; }
+
+public:
+	JParallelRecorder() = delete;
+	JParallelRecorder(const JParallelRecorder&) = delete;
+	void operator=(const JParallelRecorder&) = delete;
+
+	// drawsPerChunk trades scheduling overhead against balancing the work between threads
+	JParallelRecorder(const JDevice* device, JThreadPool* threads, uint32_t frameCount, uint32_t drawsPerChunk = 256);
+	virtual ~JParallelRecorder();
+
+	inline uint32_t drawsPerChunk() const { return _drawsPerChunk; }
+	// below this it's cheaper to record inline on one thread
+	inline bool worthRecordingInParallel(size_t drawCount) const { return drawCount >= 2 * static_cast<size_t>(_drawsPerChunk); }
+
+	// frame's fence has to have signalled, all its secondary buffers are reset and reused
+	void reset(uint32_t frame);
+
+	// records draws [0, drawCount) for frame and executes them from primary
+	// primary has to be inside subpass of renderPass, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	// recordRange(buffer, begin, end) records draws [begin, end) into buffer, it runs on worker threads
+	// and secondary buffers don't inherit any state, so it has to bind everything it uses
+	void record(uint32_t frame, VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+		size_t drawCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& recordRange);
+};
+
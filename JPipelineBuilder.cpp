@@ -0,0 +1,332 @@
+#include "JPipelineBuilder.h"
+
+#include "utils.h"
+
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+
+
+JPipelineBuilder::JPipelineBuilder(const JDevice* device, bool dynamicRaster)
+	: _pDevice(device)
+	, _dynamicRaster(dynamicRaster && device->hasExtendedDynamicState())
+{
+	// no blending, colours go through unmodified
+	_blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	_blend.blendEnable = VK_FALSE;
+	_blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	_blend.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_blend.colorBlendOp = VK_BLEND_OP_ADD;
+	_blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_blend.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+JPipelineBuilder& JPipelineBuilder::addStage(const VkPipelineShaderStageCreateInfo& stage)
+{
+	return addStage(stage, JSpecializationConstants(stage.pSpecializationInfo));
+}
+
+JPipelineBuilder& JPipelineBuilder::addStage(const VkPipelineShaderStageCreateInfo& stage, const JSpecializationConstants& constants)
+{
+	_stages.push_back(stage);
+	_stages.back().pSpecializationInfo = nullptr;
+	_constants.push_back(constants.empty() ? JSpecializationConstants(stage.pSpecializationInfo) : constants);
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::addBinding(const VkVertexInputBindingDescription& binding)
+{
+	_bindings.push_back(binding);
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::addAttribute(const VkVertexInputAttributeDescription& attribute)
+{
+	_attributes.push_back(attribute);
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::setRasterState(const JRasterState& raster)
+{
+	_raster = raster;
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::setBlend(const VkPipelineColorBlendAttachmentState& blend)
+{
+	_blend = blend;
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::setLayout(VkPipelineLayout layout)
+{
+	_layout = layout;
+	return *this;
+}
+
+JPipelineBuilder& JPipelineBuilder::setRenderPass(VkRenderPass renderPass, uint32_t subpass)
+{
+	_renderPass = renderPass;
+	_subpass = subpass;
+	return *this;
+}
+
+// dynamic topology still has to match the pipeline's topology class
+static uint32_t topologyClass(VkPrimitiveTopology topology)
+{
+	switch (topology) {
+	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+		return 0;
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+		return 1;
+	case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+		return 3;
+	default:
+		return 2; // triangles
+	}
+}
+
+std::vector<uint8_t> JPipelineBuilder::identity() const
+{
+	// field by field, the structs can have padding in them
+	std::vector<uint8_t> bytes;
+	auto add = [&bytes](const void* data, size_t size) {
+		bytes.insert(bytes.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	};
+
+	uint32_t count = static_cast<uint32_t>(_stages.size());
+	add(&count, sizeof(count));
+	for (size_t i = 0; i < _stages.size(); ++i) {
+		const VkPipelineShaderStageCreateInfo& stage = _stages[i];
+		add(&stage.stage, sizeof(stage.stage));
+		add(&stage.module, sizeof(stage.module));
+		add(stage.pName, strlen(stage.pName) + 1);
+		_constants[i].appendIdentity(bytes);
+	}
+
+	count = static_cast<uint32_t>(_bindings.size());
+	add(&count, sizeof(count));
+	for (const VkVertexInputBindingDescription& binding : _bindings) {
+		add(&binding.binding, sizeof(binding.binding));
+		add(&binding.stride, sizeof(binding.stride));
+		add(&binding.inputRate, sizeof(binding.inputRate));
+	}
+	count = static_cast<uint32_t>(_attributes.size());
+	add(&count, sizeof(count));
+	for (const VkVertexInputAttributeDescription& attribute : _attributes) {
+		add(&attribute.location, sizeof(attribute.location));
+		add(&attribute.binding, sizeof(attribute.binding));
+		add(&attribute.format, sizeof(attribute.format));
+		add(&attribute.offset, sizeof(attribute.offset));
+	}
+
+	uint32_t dynamicRaster = _dynamicRaster ? 1 : 0;
+	add(&dynamicRaster, sizeof(dynamicRaster));
+	if (_dynamicRaster) {
+		uint32_t topology = topologyClass(_raster.topology);
+		add(&topology, sizeof(topology));
+	}
+	else {
+		uint32_t depth = (_raster.depthTest ? 1 : 0) | (_raster.depthWrite ? 2 : 0);
+		add(&_raster.cullMode, sizeof(_raster.cullMode));
+		add(&_raster.frontFace, sizeof(_raster.frontFace));
+		add(&_raster.topology, sizeof(_raster.topology));
+		add(&depth, sizeof(depth));
+		add(&_raster.depthCompareOp, sizeof(_raster.depthCompareOp));
+	}
+
+	add(&_blend.blendEnable, sizeof(_blend.blendEnable));
+	add(&_blend.srcColorBlendFactor, sizeof(_blend.srcColorBlendFactor));
+	add(&_blend.dstColorBlendFactor, sizeof(_blend.dstColorBlendFactor));
+	add(&_blend.colorBlendOp, sizeof(_blend.colorBlendOp));
+	add(&_blend.srcAlphaBlendFactor, sizeof(_blend.srcAlphaBlendFactor));
+	add(&_blend.dstAlphaBlendFactor, sizeof(_blend.dstAlphaBlendFactor));
+	add(&_blend.alphaBlendOp, sizeof(_blend.alphaBlendOp));
+	add(&_blend.colorWriteMask, sizeof(_blend.colorWriteMask));
+
+	add(&_layout, sizeof(_layout));
+	add(&_renderPass, sizeof(_renderPass));
+	add(&_subpass, sizeof(_subpass));
+	return bytes;
+}
+
+uint64_t JPipelineBuilder::hash() const
+{
+	std::vector<uint8_t> bytes = identity();
+	return fnv1a(bytes.data(), bytes.size());
+}
+
+VkPipeline JPipelineBuilder::build(JPipelineCache* cache, JPipelineCreation* creation) const
+{
+	// pointed at this builder's own copies, pointers into a builder it was copied from would dangle
+	std::vector<VkSpecializationInfo> specializations(_stages.size());
+	std::vector<VkPipelineShaderStageCreateInfo> stages = _stages;
+	for (size_t i = 0; i < stages.size(); ++i) {
+		if (!_constants[i].empty()) {
+			specializations[i] = _constants[i].info();
+			stages[i].pSpecializationInfo = &specializations[i];
+		}
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(_bindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = _bindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(_attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = _attributes.data();
+
+	// with dynamic topology this only has to be the right class, the exact one is set when drawing
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = _raster.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// the counts still have to be given, the viewports and scissors themselves are dynamic
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = _raster.cullMode; // ignored if dynamic
+	rasterizer.frontFace = _raster.frontFace;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = _raster.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = _raster.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = _raster.depthCompareOp;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+	depthStencil.minDepthBounds = 0.0f;
+	depthStencil.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &_blend;
+
+	std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+#ifdef VK_EXT_extended_dynamic_state
+	if (_dynamicRaster) {
+		dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+		dynamicStates.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+		dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+		dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+		dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT);
+		dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT);
+	}
+#endif
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+	pipelineInfo.pStages = stages.data();
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = _layout;
+	pipelineInfo.renderPass = _renderPass;
+	pipelineInfo.subpass = _subpass;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// the driver says whether the cache had the pipeline, otherwise a fast creation is the only hint
+	bool feedback = false;
+#ifdef VK_EXT_pipeline_creation_feedback
+	VkPipelineCreationFeedbackEXT pipelineFeedback{};
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+	feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	if (cache != nullptr && _pDevice->hasCreationFeedback()) {
+		pipelineInfo.pNext = &feedbackInfo;
+		feedback = true;
+	}
+#endif
+
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(_pDevice->device(), cache != nullptr ? cache->cache() : VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (cache != nullptr) {
+		bool hit = false;
+#ifdef VK_EXT_pipeline_creation_feedback
+		feedback = feedback && (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) != 0;
+		hit = (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+#endif
+		cache->recordCreation(feedback, hit, seconds);
+		if (creation != nullptr) {
+			creation->feedback = feedback;
+			creation->hit = hit;
+		}
+	}
+	if (creation != nullptr) {
+		creation->seconds = seconds;
+	}
+	return pipeline;
+}
+
+void JPipelineBuilder::setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+	// viewport is transformation from image to framebuffer, so changing this would rescale, not clip
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	// scissors clip where we draw
+	VkRect2D scissor{};
+	scissor.offset = { 0,0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void JPipelineBuilder::applyRasterState(const JDevice* device, VkCommandBuffer commandBuffer, const JRasterState& raster)
+{
+	if (!device->hasExtendedDynamicState()) {
+		return;
+	}
+#ifdef VK_EXT_extended_dynamic_state
+	const JExtendedDynamicState& dynamicState = device->extendedDynamicState();
+	dynamicState.setCullMode(commandBuffer, raster.cullMode);
+	dynamicState.setFrontFace(commandBuffer, raster.frontFace);
+	dynamicState.setPrimitiveTopology(commandBuffer, raster.topology);
+	dynamicState.setDepthTestEnable(commandBuffer, raster.depthTest ? VK_TRUE : VK_FALSE);
+	dynamicState.setDepthWriteEnable(commandBuffer, raster.depthWrite ? VK_TRUE : VK_FALSE);
+	dynamicState.setDepthCompareOp(commandBuffer, raster.depthCompareOp);
+#endif
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "JDevice.h"
+#include "JPipelineCache.h"
+#include "JSpecializationConstants.h"
+
+// the rasterizer and depth state VK_EXT_extended_dynamic_state can take out of the pipeline
+// baked in as usual without the extension, set per command buffer with applyRasterState() with it,
+// so draws that only differ in these can share one pipeline
+struct JRasterState {
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	// only the topology class (points, lines, triangles) is baked in when it's dynamic
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	bool depthTest = false;
+	bool depthWrite = false;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+	inline bool operator==(const JRasterState& other) const {
+		return cullMode == other.cullMode && frontFace == other.frontFace && topology == other.topology
+			&& depthTest == other.depthTest && depthWrite == other.depthWrite && depthCompareOp == other.depthCompareOp;
+	}
+	inline bool operator!=(const JRasterState& other) const { return !(*this == other); }
+};
+
+// how creating one pipeline went
+struct JPipelineCreation {
+	double seconds = 0.0;
+	bool feedback = false; // the driver said whether it was a pipeline cache hit
+	bool hit = false;
+};
+
+// fills in a VkGraphicsPipelineCreateInfo from a handful of settings, everything else gets the usual defaults
+// (fill, no blending, no multisampling, one colour attachment)
+// viewport and scissor are always dynamic, so pipelines don't depend on the framebuffer size
+// and the raster state is too when the device has extended dynamic state
+class JPipelineBuilder
+{
+protected:
+	const JDevice* _pDevice;
+
+	std::vector<VkPipelineShaderStageCreateInfo> _stages;
+	// one per stage, copied so a builder (and its copies) can outlive whatever the caller filled in
+	// the stages' pSpecializationInfo is pointed at these in build()
+	std::vector<JSpecializationConstants> _constants;
+	std::vector<VkVertexInputBindingDescription> _bindings;
+	std::vector<VkVertexInputAttributeDescription> _attributes;
+	JRasterState _raster;
+	bool _dynamicRaster;
+	VkPipelineColorBlendAttachmentState _blend{};
+	VkPipelineLayout _layout = VK_NULL_HANDLE;
+	VkRenderPass _renderPass = VK_NULL_HANDLE;
+	uint32_t _subpass = 0;
+
+public:
+	JPipelineBuilder() = delete;
+	JPipelineBuilder(const JPipelineBuilder&) = default; // variants start as a copy of a base builder
+	void operator=(const JPipelineBuilder&) = delete;
+
+	// dynamicRaster is ignored if the device doesn't have extended dynamic state
+	JPipelineBuilder(const JDevice* device, bool dynamicRaster = true);
+
+	inline bool dynamicRaster() const { return _dynamicRaster; }
+	inline const JRasterState& rasterState() const { return _raster; }
+
+	// a pSpecializationInfo already in stage is copied, constants (if not empty) is used instead of it
+	JPipelineBuilder& addStage(const VkPipelineShaderStageCreateInfo& stage);
+	JPipelineBuilder& addStage(const VkPipelineShaderStageCreateInfo& stage, const JSpecializationConstants& constants);
+	JPipelineBuilder& addBinding(const VkVertexInputBindingDescription& binding);
+	JPipelineBuilder& addAttribute(const VkVertexInputAttributeDescription& attribute);
+	JPipelineBuilder& setRasterState(const JRasterState& raster);
+	JPipelineBuilder& setBlend(const VkPipelineColorBlendAttachmentState& blend);
+	JPipelineBuilder& setLayout(VkPipelineLayout layout);
+	JPipelineBuilder& setRenderPass(VkRenderPass renderPass, uint32_t subpass = 0);
+
+	inline VkRenderPass renderPass() const { return _renderPass; }
+
+	// identifies the pipeline build() would make: everything that goes into it, as bytes, so two builders
+	// can be compared exactly
+	// raster state that's left dynamic isn't included, so variants that only differ in it share a pipeline
+	// shader modules, the layout and the render pass go in by handle, so the same code in two modules
+	// counts as different, and a handle the driver reuses after destroying the old object looks the same
+	// (see JPipelineManager::release)
+	// specialization constants go in by value, every set of them is its own pipeline
+	std::vector<uint8_t> identity() const;
+	// fnv1a of identity(), for bucketing, two builders can hash the same without being the same
+	uint64_t hash() const;
+
+	// throws if creation fails, the caller owns the pipeline
+	// with a cache, the creation time (and whether it was a cache hit, if the device can say) goes into its
+	// stats, and into creation if that's given
+	VkPipeline build(JPipelineCache* cache = nullptr, JPipelineCreation* creation = nullptr) const;
+
+	// sets the viewport and scissor to the whole of extent, every command buffer that draws needs this
+	// (secondaries don't inherit it)
+	static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
+	// sets the raster state a dynamicRaster pipeline left out, does nothing without extended dynamic state
+	static void applyRasterState(const JDevice* device, VkCommandBuffer commandBuffer, const JRasterState& raster);
+};
@@ -0,0 +1,198 @@
+#include "JPipelineCache.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+
+
+JPipelineCache::JPipelineCache(const JDevice* device, const std::string& filename)
+	: _pDevice(device)
+	, _filename(filename)
+{
+	vkGetPhysicalDeviceProperties(_pDevice->physical(), &_properties);
+
+	std::string reason;
+	uint64_t checksum = 0;
+	std::vector<char> data = readCacheFile(reason, checksum);
+	_stats.rejected = reason;
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+	if (vkCreatePipelineCache(_pDevice->device(), &createInfo, nullptr, &_cache) != VK_SUCCESS) {
+		// the driver can refuse data even when the header checks out, start empty
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		data.clear();
+		_stats.rejected = "refused by the driver";
+		if (vkCreatePipelineCache(_pDevice->device(), &createInfo, nullptr, &_cache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+	if (!data.empty()) {
+		_stats.loaded = true;
+		_stats.loadedBytes = data.size();
+		_loadedChecksum = checksum;
+	}
+}
+
+JPipelineCache::~JPipelineCache()
+{
+	vkDestroyPipelineCache(_pDevice->device(), _cache, nullptr);
+}
+
+std::vector<char> JPipelineCache::readCacheFile(std::string& reason, uint64_t& checksum) const
+{
+	std::vector<char> empty;
+	std::ifstream file(_filename, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return empty; // not an error, there's just no cache yet
+	}
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	FileHeader header{};
+	if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		reason = "truncated header";
+		return empty;
+	}
+	if (memcmp(header.magic, "JPLC", 4) != 0 || header.version != FILE_VERSION) {
+		reason = "not a pipeline cache file";
+		return empty;
+	}
+	// a new driver version can change what's in the cache without changing the UUID
+	if (header.vendorID != _properties.vendorID || header.deviceID != _properties.deviceID
+		|| header.driverVersion != _properties.driverVersion
+		|| memcmp(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		reason = "different device or driver";
+		return empty;
+	}
+	if (header.dataSize != fileSize - sizeof(header)) {
+		reason = "truncated data";
+		return empty;
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.dataSize));
+	if (!file.read(data.data(), data.size()) || fnv1a(data.data(), data.size()) != header.checksum) {
+		reason = "bad checksum";
+		return empty;
+	}
+
+	// and the driver's own header, which should agree with ours
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if (data.size() < sizeof(driverHeader)) {
+		reason = "truncated driver header";
+		return empty;
+	}
+	memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+	if (driverHeader.headerSize < sizeof(driverHeader) || driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		|| driverHeader.vendorID != _properties.vendorID || driverHeader.deviceID != _properties.deviceID
+		|| memcmp(driverHeader.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		reason = "driver header mismatch";
+		return empty;
+	}
+
+	checksum = header.checksum;
+	return data;
+}
+
+void JPipelineCache::merge(const std::vector<VkPipelineCache>& caches)
+{
+	if (caches.empty()) {
+		return;
+	}
+	if (vkMergePipelineCaches(_pDevice->device(), _cache, static_cast<uint32_t>(caches.size()), caches.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to merge pipeline caches!");
+	}
+}
+
+bool JPipelineCache::save()
+{
+	// another run might have saved since this one loaded, keep what it compiled too
+	std::string reason;
+	uint64_t checksum = 0;
+	std::vector<char> onDisk = readCacheFile(reason, checksum);
+	if (!onDisk.empty() && checksum != _loadedChecksum) {
+		VkPipelineCacheCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = onDisk.size();
+		createInfo.pInitialData = onDisk.data();
+		VkPipelineCache other;
+		if (vkCreatePipelineCache(_pDevice->device(), &createInfo, nullptr, &other) == VK_SUCCESS) {
+			merge({ other });
+			vkDestroyPipelineCache(_pDevice->device(), other, nullptr);
+		}
+	}
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(_pDevice->device(), _cache, &size, nullptr) != VK_SUCCESS) {
+		return false;
+	}
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(_pDevice->device(), _cache, &size, data.data()) != VK_SUCCESS) {
+		return false;
+	}
+	data.resize(size);
+
+	FileHeader header{};
+	memcpy(header.magic, "JPLC", 4);
+	header.version = FILE_VERSION;
+	header.vendorID = _properties.vendorID;
+	header.deviceID = _properties.deviceID;
+	header.driverVersion = _properties.driverVersion;
+	memcpy(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.checksum = fnv1a(data.data(), data.size());
+
+	std::string temporary = _filename + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		file.flush();
+		if (!file.good()) {
+			file.close();
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	// replaces the old file in one go (std::rename won't overwrite on windows)
+	std::error_code error;
+	std::filesystem::rename(temporary, _filename, error);
+	if (error) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	_loadedChecksum = header.checksum;
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	_stats.savedBytes = data.size();
+	return true;
+}
+
+void JPipelineCache::recordCreation(bool feedback, bool hit, double seconds)
+{
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	++_stats.pipelines;
+	_stats.seconds += seconds;
+	if (feedback) {
+		if (hit) {
+			++_stats.hits;
+			_stats.hitSeconds += seconds;
+		}
+		else {
+			++_stats.misses;
+			_stats.missSeconds += seconds;
+		}
+	}
+}
+
+JPipelineCacheStats JPipelineCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	return _stats;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+#include "JDevice.h"
+
+// how the pipeline cache file went and what pipeline creation through the cache cost
+struct JPipelineCacheStats {
+	bool loaded = false; // the file was there and valid for this device and driver
+	std::string rejected; // why the file wasn't used, empty if it was (or there wasn't one)
+	size_t loadedBytes = 0;
+	size_t savedBytes = 0;
+
+	uint32_t pipelines = 0;
+	// from VK_EXT_pipeline_creation_feedback, pipelines created without it are neither
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	double seconds = 0.0; // wall clock in vkCreateGraphicsPipelines, over every pipeline
+	double hitSeconds = 0.0;
+	double missSeconds = 0.0;
+
+	inline uint32_t unknown() const { return pipelines - hits - misses; }
+};
+
+// a VkPipelineCache that's loaded from a file at startup and written back with save()
+// the file has a header of its own in front of the driver's data, with the device, driver version and
+// a checksum, the driver's data is only handed over if that and the driver's own header match, since
+// some drivers don't cope well with data from another driver (or a truncated file)
+// creating pipelines through it is thread safe (VkPipelineCache is internally synchronised)
+class JPipelineCache
+{
+protected:
+	// in front of the driver's data in the file
+	struct FileHeader {
+		char magic[4]; // "JPLC"
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum; // fnv1a of the data
+	};
+	static const uint32_t FILE_VERSION = 1;
+
+	const JDevice* _pDevice;
+	std::string _filename;
+	VkPipelineCache _cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties _properties;
+	uint64_t _loadedChecksum = 0; // of the data in the file when it was loaded, 0 if nothing was
+
+	mutable std::mutex _statsMutex;
+	JPipelineCacheStats _stats;
+
+	// the driver's data out of a cache file, empty (and reason set) if it's not usable
+	std::vector<char> readCacheFile(std::string& reason, uint64_t& checksum) const;
+
+public:
+	JPipelineCache() = delete;
+	JPipelineCache(const JPipelineCache&) = delete;
+	void operator=(const JPipelineCache&) = delete;
+
+	// a missing or invalid file just means starting with an empty cache
+	JPipelineCache(const JDevice* device, const std::string& filename);
+	// doesn't save
+	virtual ~JPipelineCache();
+
+	inline VkPipelineCache cache() const { return _cache; }
+	inline const std::string& filename() const { return _filename; }
+
+	// folds other caches (one per thread, say) into this one, they're left as they are
+	void merge(const std::vector<VkPipelineCache>& caches);
+
+	// merges in anything another run saved to the file since it was loaded, then writes the file to a
+	// temporary and renames it over the old one, so a crash never leaves half a cache behind
+	// returns false (and leaves the old file) if it couldn't be written
+	bool save();
+
+	// for whatever creates pipelines with cache(), see JPipelineBuilder::build
+	void recordCreation(bool feedback, bool hit, double seconds);
+	JPipelineCacheStats stats() const;
+};
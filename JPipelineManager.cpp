@@ -0,0 +1,228 @@
+#include "JPipelineManager.h"
+
+#include "utils.h"
+
+#include <stdexcept>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+
+
+void JCompileHistogram::record(double s)
+{
+	double ms = s * 1000.0;
+	uint32_t bucket = 0;
+	for (double limit = 1.0; bucket < BUCKETS - 1 && ms >= limit; limit *= 2.0) {
+		++bucket;
+	}
+	++buckets[bucket];
+	++count;
+	seconds += s;
+	maxSeconds = std::max(maxSeconds, s);
+}
+
+std::string JCompileHistogram::toString() const
+{
+	uint32_t first = 0;
+	while (first < BUCKETS && buckets[first] == 0) {
+		++first;
+	}
+	uint32_t last = BUCKETS;
+	while (last > first && buckets[last - 1] == 0) {
+		--last;
+	}
+
+	std::ostringstream out;
+	for (uint32_t i = first; i < last; ++i) {
+		if (i > first) {
+			out << " ";
+		}
+		if (i == BUCKETS - 1) {
+			out << ">=" << (1u << (BUCKETS - 2)) << "ms:" << buckets[i];
+		}
+		else {
+			out << "<" << (1u << i) << "ms:" << buckets[i];
+		}
+	}
+	return out.str();
+}
+
+JPipelineManager::JPipelineManager(const JDevice* device, JPipelineCache* cache, JThreadPool* threads)
+	: _pDevice(device)
+	, _cache(cache)
+	, _threads(threads)
+{
+}
+
+JPipelineManager::~JPipelineManager()
+{
+	waitIdle();
+	for (auto& entry : _variants) {
+		if (entry.second.pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(_pDevice->device(), entry.second.pipeline, nullptr);
+		}
+	}
+	_variants.clear();
+	_buckets.clear();
+}
+
+uint64_t JPipelineManager::request(const JPipelineBuilder& builder)
+{
+	std::vector<uint8_t> identity = builder.identity();
+	uint64_t hash = fnv1a(identity.data(), identity.size());
+	uint64_t key;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::vector<uint64_t>& bucket = _buckets[hash];
+		for (uint64_t existing : bucket) {
+			if (_variants.at(existing).identity == identity) {
+				return existing; // ready, failed or already on its way
+			}
+		}
+		key = _nextKey++;
+		Variant& variant = _variants[key];
+		variant.identity = std::move(identity);
+		variant.renderPass = builder.renderPass();
+		bucket.push_back(key);
+		++_stats.variants;
+		++_stats.pending;
+	}
+
+	// the task has to be copyable, and has to own its copy of the builder
+	auto copy = std::make_shared<JPipelineBuilder>(builder);
+	_threads->submit([this, key, copy](uint32_t) { compile(key, *copy); });
+	return key;
+}
+
+void JPipelineManager::compile(uint64_t key, const JPipelineBuilder& builder)
+{
+	// runs on a worker, which mustn't throw
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	JPipelineCreation creation;
+	std::string error;
+	try {
+		pipeline = builder.build(_cache, &creation);
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// release() waits for pending variants, so it's still here
+		Variant& variant = _variants.at(key);
+		variant.pipeline = pipeline;
+		variant.state = pipeline != VK_NULL_HANDLE ? VariantState::JReady : VariantState::JFailed;
+		variant.error = error;
+		--_stats.pending;
+		if (variant.state == VariantState::JFailed) {
+			++_stats.failed;
+		}
+		else {
+			_stats.compiles.record(creation.seconds);
+			if (creation.feedback) {
+				(creation.hit ? _stats.hits : _stats.misses).record(creation.seconds);
+			}
+		}
+		// under the lock, the destructor can run as soon as pending hits 0
+		_compiled.notify_all();
+	}
+}
+
+std::vector<VkPipeline> JPipelineManager::release(VkRenderPass renderPass)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_compiled.wait(lock, [this, renderPass]() {
+		for (const auto& entry : _variants) {
+			if (entry.second.renderPass == renderPass && entry.second.state == VariantState::JPending) {
+				return false;
+			}
+		}
+		return true;
+	});
+
+	std::vector<VkPipeline> pipelines;
+	for (auto bucket = _buckets.begin(); bucket != _buckets.end();) {
+		std::vector<uint64_t>& keys = bucket->second;
+		for (size_t i = 0; i < keys.size();) {
+			auto found = _variants.find(keys[i]);
+			if (found->second.renderPass != renderPass) {
+				++i;
+				continue;
+			}
+			if (found->second.pipeline != VK_NULL_HANDLE) {
+				pipelines.push_back(found->second.pipeline);
+			}
+			if (found->second.state == VariantState::JFailed) {
+				--_stats.failed;
+			}
+			--_stats.variants;
+			_variants.erase(found);
+			keys[i] = keys.back();
+			keys.pop_back();
+		}
+		bucket = keys.empty() ? _buckets.erase(bucket) : std::next(bucket);
+	}
+	return pipelines;
+}
+
+VkPipeline JPipelineManager::pipeline(uint64_t key) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _variants.find(key);
+	return found != _variants.end() ? found->second.pipeline : VK_NULL_HANDLE;
+}
+
+bool JPipelineManager::ready(uint64_t key) const
+{
+	return pipeline(key) != VK_NULL_HANDLE;
+}
+
+VkPipeline JPipelineManager::resolve(uint64_t key, uint64_t fallback, uint64_t drawCount)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _variants.find(key);
+	if (found != _variants.end() && found->second.pipeline != VK_NULL_HANDLE) {
+		return found->second.pipeline;
+	}
+	if (fallback != 0) {
+		found = _variants.find(fallback);
+		if (found != _variants.end() && found->second.pipeline != VK_NULL_HANDLE) {
+			_stats.fallbackDraws += drawCount;
+			return found->second.pipeline;
+		}
+	}
+	_stats.skippedDraws += drawCount;
+	return VK_NULL_HANDLE;
+}
+
+VkPipeline JPipelineManager::wait(uint64_t key)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	// looked up again every time, release() can take it away while this is waiting
+	auto found = _variants.find(key);
+	_compiled.wait(lock, [this, key, &found]() {
+		found = _variants.find(key);
+		return found == _variants.end() || found->second.state != VariantState::JPending;
+	});
+	if (found == _variants.end()) {
+		throw std::runtime_error("waiting for a pipeline that was never requested (or was released)!");
+	}
+	if (found->second.state == VariantState::JFailed) {
+		throw std::runtime_error(found->second.error);
+	}
+	return found->second.pipeline;
+}
+
+void JPipelineManager::waitIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_compiled.wait(lock, [this]() { return _stats.pending == 0; });
+}
+
+JPipelineManagerStats JPipelineManager::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
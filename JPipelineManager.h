@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "JDevice.h"
+#include "JThreadPool.h"
+#include "JPipelineBuilder.h"
+#include "JPipelineCache.h"
+
+// compile times bucketed by powers of two milliseconds
+struct JCompileHistogram {
+	static const uint32_t BUCKETS = 12; // under 1ms, under 2ms, under 4ms... under 1024ms, and slower than that
+	uint32_t buckets[BUCKETS] = {};
+	uint32_t count = 0;
+	double seconds = 0.0;
+	double maxSeconds = 0.0;
+
+	void record(double seconds);
+	// "<1ms:3 <2ms:1 ... >=1024ms:0", empty buckets at either end left out
+	std::string toString() const;
+};
+
+struct JPipelineManagerStats {
+	JCompileHistogram compiles; // every variant
+	JCompileHistogram hits; // only with creation feedback, see JPipelineCreation
+	JCompileHistogram misses;
+	uint32_t variants = 0; // ready, pending and failed
+	uint32_t pending = 0;
+	uint32_t failed = 0;
+	uint64_t fallbackDraws = 0; // drawn with the fallback variant, the one asked for wasn't ready
+	uint64_t skippedDraws = 0; // not drawn at all, neither was ready
+};
+
+// pipelines by everything that goes into them (JPipelineBuilder::identity), compiled on a JThreadPool
+// the first time they're asked for, so a frame never waits for the driver's compiler
+// until a variant is ready, draws can use another one that is (a fallback) or be skipped
+// the builder's shader modules have to outlive the compile, owns the pipelines, thread safe
+class JPipelineManager
+{
+protected:
+	enum class VariantState {
+		JPending, JReady, JFailed
+	};
+	struct Variant {
+		VariantState state = VariantState::JPending;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::string error; // why it failed
+		std::vector<uint8_t> identity; // compared on lookup, the hash only picks the bucket
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+	};
+
+	const JDevice* _pDevice;
+	JPipelineCache* _cache;
+	JThreadPool* _threads;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _compiled;
+	// by key, keys are handed out in order and never reused (0 is "none")
+	std::unordered_map<uint64_t, Variant> _variants;
+	// JPipelineBuilder::hash to the keys of the variants with it, like JLayoutCache's buckets
+	std::unordered_map<uint64_t, std::vector<uint64_t>> _buckets;
+	uint64_t _nextKey = 1;
+	JPipelineManagerStats _stats;
+
+	void compile(uint64_t key, const JPipelineBuilder& builder);
+
+public:
+	JPipelineManager() = delete;
+	JPipelineManager(const JPipelineManager&) = delete;
+	void operator=(const JPipelineManager&) = delete;
+
+	// cache can be nullptr
+	JPipelineManager(const JDevice* device, JPipelineCache* cache, JThreadPool* threads);
+	// waits for the compiles that are still going, then destroys every pipeline, so only once the device is idle
+	virtual ~JPipelineManager();
+
+	// the key of the variant builder describes, it's compiled in the background if it's new
+	uint64_t request(const JPipelineBuilder& builder);
+
+	// forgets every variant built against renderPass, waiting for the ones still compiling, and hands back
+	// their pipelines for the caller to destroy (once the GPU is done with them)
+	// has to be called before renderPass is destroyed, otherwise a compile could still be using it, and a
+	// new render pass that gets the same handle would be given the old one's pipelines
+	std::vector<VkPipeline> release(VkRenderPass renderPass);
+
+	// VK_NULL_HANDLE until it's ready (or if it failed)
+	VkPipeline pipeline(uint64_t key) const;
+	bool ready(uint64_t key) const;
+
+	// what drawCount draws that want key should use this frame: key if it's ready, otherwise fallback
+	// if that is (0 for none), otherwise VK_NULL_HANDLE and the draws should be skipped
+	VkPipeline resolve(uint64_t key, uint64_t fallback = 0, uint64_t drawCount = 1);
+
+	// blocks until key is compiled, throws if it failed (or was released)
+	VkPipeline wait(uint64_t key);
+	// blocks until nothing is compiling
+	void waitIdle();
+
+	JPipelineManagerStats stats() const;
+};
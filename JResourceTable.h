@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <stdexcept>
+#include <cstdint>
+
+// refers to a slot in a JResourceTable<T>
+// the generation tells a handle to a destroyed resource apart from one to whatever reused its slot
+template<typename T>
+struct JHandle {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	inline bool isNull() const { return index == UINT32_MAX; }
+	inline bool operator==(const JHandle& other) const { return index == other.index && generation == other.generation; }
+	inline bool operator!=(const JHandle& other) const { return !(*this == other); }
+};
+
+// slot map of resources stored by value, in one contiguous vector
+// freed slots are reused, and handles to them go stale instead of pointing at the new resource
+// T has to be movable (the vector moves resources around as it grows), so pointers and references
+// into the table are only good until the next insert, hold on to handles instead
+template<typename T>
+class JResourceTable
+{
+protected:
+	std::vector<std::optional<T>> _slots;
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _freeSlots;
+	size_t _count = 0;
+
+public:
+	JResourceTable() = default;
+	JResourceTable(const JResourceTable&) = delete;
+	void operator=(const JResourceTable&) = delete;
+
+	inline size_t size() const { return _count; }
+	inline bool empty() const { return _count == 0; }
+	inline void reserve(size_t n) { _slots.reserve(n); _generations.reserve(n); }
+
+	// constructs the resource in place, returns its handle
+	template<typename... Args>
+	JHandle<T> emplace(Args&&... args) {
+		JHandle<T> handle;
+		if (!_freeSlots.empty()) {
+			handle.index = _freeSlots.back();
+			_slots[handle.index].emplace(std::forward<Args>(args)...);
+			_freeSlots.pop_back();
+		}
+		else {
+			handle.index = static_cast<uint32_t>(_slots.size());
+			_slots.emplace_back(std::in_place, std::forward<Args>(args)...);
+			_generations.push_back(0);
+		}
+		handle.generation = _generations[handle.index];
+		++_count;
+		return handle;
+	}
+	inline JHandle<T> insert(T&& resource) { return emplace(std::move(resource)); }
+
+	inline bool contains(JHandle<T> handle) const {
+		return handle.index < _slots.size() && _generations[handle.index] == handle.generation && _slots[handle.index].has_value();
+	}
+
+	// nullptr if the handle is stale
+	inline T* get(JHandle<T> handle) { return contains(handle) ? &*_slots[handle.index] : nullptr; }
+	inline const T* get(JHandle<T> handle) const { return contains(handle) ? &*_slots[handle.index] : nullptr; }
+
+	// throws if the handle is stale
+	inline T& operator[](JHandle<T> handle) {
+		if (!contains(handle)) {
+			throw std::runtime_error("stale or null resource handle!");
+		}
+		return *_slots[handle.index];
+	}
+	inline const T& operator[](JHandle<T> handle) const {
+		if (!contains(handle)) {
+			throw std::runtime_error("stale or null resource handle!");
+		}
+		return *_slots[handle.index];
+	}
+
+	// destroys the resource, does nothing if the handle is already stale
+	void erase(JHandle<T> handle) {
+		if (!contains(handle)) {
+			return;
+		}
+		_slots[handle.index].reset();
+		++_generations[handle.index];
+		_freeSlots.push_back(handle.index);
+		--_count;
+	}
+
+	// destroys everything, every handle goes stale
+	void clear() {
+		for (uint32_t i = 0; i < _slots.size(); ++i) {
+			if (_slots[i].has_value()) {
+				erase(JHandle<T>{ i, _generations[i] });
+			}
+		}
+	}
+
+	// calls function(handle, resource) for every live resource, in slot order
+	template<typename F>
+	void forEach(F function) {
+		for (uint32_t i = 0; i < _slots.size(); ++i) {
+			if (_slots[i].has_value()) {
+				function(JHandle<T>{ i, _generations[i] }, *_slots[i]);
+			}
+		}
+	}
+};
+
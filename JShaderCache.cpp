@@ -0,0 +1,79 @@
+#include "JShaderCache.h"
+#include "JMappedFile.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <cstring>
+
+
+const constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+const constexpr size_t SPIRV_HEADER_SIZE = 5 * sizeof(uint32_t); // magic, version, generator, bound, schema
+
+size_t JShaderCache::KeyHash::operator()(const Key& key) const
+{
+	// the code's hash is already a good one, just fold the rest in
+	uint64_t h = fnv1a(&key.type, sizeof(key.type), key.hash);
+	h = fnv1a(key.entrypoint.data(), key.entrypoint.size(), h);
+	return static_cast<size_t>(h);
+}
+
+JShaderCache::JShaderCache(const JDevice* device)
+	: _pDevice(device)
+{
+}
+
+JShaderCache::~JShaderCache()
+{
+	_modules.clear();
+}
+
+const JShaderModule* JShaderCache::load(JShaderType type, const std::string& filename, const char* entrypoint)
+{
+	JMappedFile file(filename);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stats.mappedBytes += file.size();
+	}
+	return get(type, file.data(), file.size(), entrypoint);
+}
+
+const JShaderModule* JShaderCache::get(JShaderType type, const void* code, size_t size, const char* entrypoint)
+{
+	uint32_t magic = 0;
+	if (size < SPIRV_HEADER_SIZE || size % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("invalid SPIR-V, wrong size!");
+	}
+	memcpy(&magic, code, sizeof(magic));
+	if (magic != SPIRV_MAGIC) {
+		throw std::runtime_error("invalid SPIR-V, bad magic number!");
+	}
+
+	// hashed outside the lock, it's the slow part
+	Key key{ fnv1a(code, size), size, type, entrypoint };
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_stats.loads;
+	auto found = _modules.find(key);
+	if (found != _modules.end()) {
+		++_stats.hits;
+		return found->second.get();
+	}
+
+	// inserted first, so the module can point at the key's copy of the entry point
+	auto inserted = _modules.emplace(std::move(key), nullptr).first;
+	try {
+		inserted->second = std::make_unique<JShaderModule>(_pDevice, type, code, size, inserted->first.entrypoint.c_str());
+	}
+	catch (...) {
+		_modules.erase(inserted);
+		throw;
+	}
+	++_stats.modules;
+	return inserted->second.get();
+}
+
+JShaderCacheStats JShaderCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
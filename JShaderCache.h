@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+#include "JDevice.h"
+#include "JShaderModule.h"
+
+struct JShaderCacheStats {
+	uint32_t loads = 0; // every load() and get()
+	uint32_t hits = 0; // the same code was already a module, nothing was created
+	uint32_t modules = 0; // what's alive now
+	uint64_t mappedBytes = 0; // read from files, all of it mapped rather than copied
+};
+
+// shader modules by the hash of their SPIR-V (with the stage and entry point), so loading the same code
+// twice, from one file or from two, gives back the same module instead of another VkShaderModule
+// files are memory mapped and handed to the driver straight from the mapping, then unmapped again
+// modules live until the cache does, so they survive swap chain recreation and pipelines can be
+// compiled from them in the background at any point, thread safe
+class JShaderCache
+{
+protected:
+	struct Key {
+		uint64_t hash;
+		size_t size;
+		JShaderType type;
+		std::string entrypoint;
+
+		inline bool operator==(const Key& other) const {
+			return hash == other.hash && size == other.size && type == other.type && entrypoint == other.entrypoint;
+		}
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	const JDevice* _pDevice;
+
+	mutable std::mutex _mutex;
+	// the modules' entry points point into the keys, which unordered_map never moves
+	std::unordered_map<Key, std::unique_ptr<JShaderModule>, KeyHash> _modules;
+	JShaderCacheStats _stats;
+
+public:
+	JShaderCache() = delete;
+	JShaderCache(const JShaderCache&) = delete;
+	void operator=(const JShaderCache&) = delete;
+
+	JShaderCache(const JDevice* device);
+	// destroys every module, so only once no pipeline is being compiled from them
+	virtual ~JShaderCache();
+
+	// throws if the file can't be read or isn't SPIR-V
+	const JShaderModule* load(JShaderType type, const std::string& filename, const char* entrypoint = "main");
+	// the same for code that's already in memory (4 byte aligned), it isn't kept after this returns
+	const JShaderModule* get(JShaderType type, const void* code, size_t size, const char* entrypoint = "main");
+
+	JShaderCacheStats stats() const;
+};
@@ -0,0 +1,354 @@
+#include "JShaderCompiler.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+
+
+// false if it can't be opened, doesn't throw like readFile
+static bool readText(const std::string& filename, std::string& text)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	text = contents.str();
+	return true;
+}
+
+static shaderc_shader_kind shaderKind(JShaderType type)
+{
+	switch (type) {
+	case JShaderType::JVertex:
+		return shaderc_vertex_shader;
+	case JShaderType::JFragment:
+		return shaderc_fragment_shader;
+	default:
+		throw std::runtime_error("no shader kind for this shader type!");
+	}
+}
+
+// resolves #includes for shaderc, and writes down every file it hands over so the cache entry can be
+// checked against them later
+class JShaderCompiler::Includer : public shaderc::CompileOptions::IncluderInterface
+{
+protected:
+	// kept alive until shaderc releases it
+	struct Include {
+		shaderc_include_result result{};
+		std::string filename;
+		std::string content;
+	};
+
+	const std::vector<std::string>& _includeDirectories;
+	std::vector<Dependency>& _dependencies;
+
+public:
+	Includer(const std::vector<std::string>& includeDirectories, std::vector<Dependency>& dependencies)
+		: _includeDirectories(includeDirectories)
+		, _dependencies(dependencies)
+	{
+	}
+
+	shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+	{
+		Include* include = new Include();
+
+		std::vector<std::filesystem::path> candidates;
+		if (type == shaderc_include_type_relative) {
+			candidates.push_back(std::filesystem::path(requestingSource).parent_path() / requestedSource);
+		}
+		for (const std::string& directory : _includeDirectories) {
+			candidates.push_back(std::filesystem::path(directory) / requestedSource);
+		}
+		for (const std::filesystem::path& candidate : candidates) {
+			std::string filename = candidate.lexically_normal().generic_string();
+			if (readText(filename, include->content)) {
+				include->filename = filename;
+				_dependencies.push_back({ filename, fnv1a(include->content.data(), include->content.size()) });
+				break;
+			}
+		}
+		// an empty name tells shaderc it failed, the content is then the error message
+		if (include->filename.empty()) {
+			include->content = std::string("couldn't find include ") + requestedSource;
+		}
+
+		include->result.source_name = include->filename.c_str();
+		include->result.source_name_length = include->filename.size();
+		include->result.content = include->content.c_str();
+		include->result.content_length = include->content.size();
+		include->result.user_data = include;
+		return &include->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* data) override
+	{
+		delete static_cast<Include*>(data->user_data);
+	}
+};
+
+JShaderCompiler::JShaderCompiler(const std::string& cacheDirectory, const std::vector<std::string>& includeDirectories, bool optimize)
+	: _cacheDirectory(cacheDirectory)
+	, _includeDirectories(includeDirectories)
+	, _optimize(optimize)
+{
+	if (!_compiler.IsValid()) {
+		throw std::runtime_error("failed to create shader compiler!");
+	}
+	// not fatal, every entry just fails to save
+	std::error_code error;
+	std::filesystem::create_directories(_cacheDirectory, error);
+}
+
+uint64_t JShaderCompiler::key(const JShaderSource& source, const std::string& text) const
+{
+	uint64_t h = FNV_OFFSET_BASIS;
+	auto add = [&h](const void* data, size_t size) { h = fnv1a(data, size, h); };
+	// with the length first, so "ab" "c" and "a" "bc" don't hash the same
+	auto addString = [&add](const std::string& string) {
+		uint32_t length = static_cast<uint32_t>(string.size());
+		add(&length, sizeof(length));
+		add(string.data(), string.size());
+	};
+
+	// a new shaderc can compile the same source differently
+	unsigned int spvVersion = 0;
+	unsigned int spvRevision = 0;
+	shaderc_get_spv_version(&spvVersion, &spvRevision);
+	uint32_t version = CACHE_VERSION;
+	uint32_t type = source.type;
+	uint32_t optimize = _optimize ? 1 : 0;
+	add(&version, sizeof(version));
+	add(&spvVersion, sizeof(spvVersion));
+	add(&spvRevision, sizeof(spvRevision));
+	add(&type, sizeof(type));
+	add(&optimize, sizeof(optimize));
+
+	addString(source.filename); // relative includes depend on where it is
+	addString(source.entrypoint);
+	addString(text);
+	uint32_t count = static_cast<uint32_t>(source.defines.size());
+	add(&count, sizeof(count));
+	for (const auto& define : source.defines) {
+		addString(define.first);
+		addString(define.second);
+	}
+	return h;
+}
+
+std::string JShaderCompiler::cacheFilename(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(_cacheDirectory) / name).generic_string();
+}
+
+bool JShaderCompiler::readCache(uint64_t key, CacheEntry& entry) const
+{
+	std::unique_ptr<JMappedFile> file;
+	try {
+		file = std::make_unique<JMappedFile>(cacheFilename(key));
+	}
+	catch (const std::runtime_error&) {
+		return false; // not there yet
+	}
+
+	CacheHeader header{};
+	if (file->size() < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, file->data(), sizeof(header));
+	if (memcmp(header.magic, "JSPV", 4) != 0 || header.version != CACHE_VERSION || header.key != key) {
+		return false;
+	}
+	const char* data = reinterpret_cast<const char*>(file->data()) + sizeof(header);
+	size_t dataSize = file->size() - sizeof(header);
+	if (fnv1a(data, dataSize) != header.checksum) {
+		return false;
+	}
+
+	// the includes have to be what they were when it was compiled
+	size_t offset = 0;
+	for (uint32_t i = 0; i < header.dependencyCount; ++i) {
+		uint32_t length = 0;
+		uint64_t hash = 0;
+		if (offset + sizeof(length) > dataSize) {
+			return false;
+		}
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+		if (offset + length + sizeof(hash) > dataSize) {
+			return false;
+		}
+		std::string filename(data + offset, length);
+		offset += length;
+		memcpy(&hash, data + offset, sizeof(hash));
+		offset += sizeof(hash);
+
+		std::string text;
+		if (!readText(filename, text) || fnv1a(text.data(), text.size()) != hash) {
+			return false;
+		}
+	}
+	offset = (offset + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+
+	if (offset > dataSize || dataSize - offset != header.codeSize * sizeof(uint32_t) || header.codeSize == 0) {
+		return false;
+	}
+	// the mapping is page aligned and the header a multiple of 4 bytes, so this is aligned too
+	entry.code = reinterpret_cast<const uint32_t*>(data + offset);
+	entry.codeSize = header.codeSize;
+	entry.file = std::move(file);
+	return true;
+}
+
+void JShaderCompiler::writeCache(uint64_t key, const std::vector<Dependency>& dependencies, const std::vector<uint32_t>& code)
+{
+	std::vector<char> data;
+	auto append = [&data](const void* bytes, size_t size) {
+		data.insert(data.end(), static_cast<const char*>(bytes), static_cast<const char*>(bytes) + size);
+	};
+	for (const Dependency& dependency : dependencies) {
+		uint32_t length = static_cast<uint32_t>(dependency.filename.size());
+		append(&length, sizeof(length));
+		append(dependency.filename.data(), dependency.filename.size());
+		append(&dependency.hash, sizeof(dependency.hash));
+	}
+	data.resize((data.size() + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1), 0);
+	append(code.data(), code.size() * sizeof(uint32_t));
+
+	CacheHeader header{};
+	memcpy(header.magic, "JSPV", 4);
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	header.codeSize = static_cast<uint32_t>(code.size());
+	header.checksum = fnv1a(data.data(), data.size());
+
+	// written to the side and renamed over, so a reader never sees half an entry
+	std::string filename = cacheFilename(key);
+	std::string temporary = filename + ".tmp" + std::to_string(_temporaryCount++);
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		file.flush();
+		if (!file.good()) {
+			file.close();
+			std::remove(temporary.c_str());
+			return; // it'll just be compiled again next time
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, filename, error);
+	if (error) {
+		std::remove(temporary.c_str());
+	}
+}
+
+void JShaderCompiler::record(uint32_t JShaderCompilerStats::* counter, std::chrono::steady_clock::time_point start)
+{
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	++(_stats.*counter);
+	_stats.seconds += seconds;
+}
+
+uint64_t JShaderCompiler::readSource(const JShaderSource& source, std::string& text, std::chrono::steady_clock::time_point start)
+{
+	if (!readText(source.filename, text)) {
+		record(&JShaderCompilerStats::failed, start);
+		throw std::runtime_error("failed to open shader source " + source.filename + "!");
+	}
+	return key(source, text);
+}
+
+std::vector<uint32_t> JShaderCompiler::compileSource(const JShaderSource& source, const std::string& text, uint64_t cacheKey,
+	std::chrono::steady_clock::time_point start)
+{
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	if (_optimize) {
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	}
+	for (const auto& define : source.defines) {
+		options.AddMacroDefinition(define.first, define.second);
+	}
+	std::vector<Dependency> dependencies;
+	options.SetIncluder(std::make_unique<Includer>(_includeDirectories, dependencies));
+
+	shaderc::SpvCompilationResult result = _compiler.CompileGlslToSpv(text, shaderKind(source.type),
+		source.filename.c_str(), source.entrypoint.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		record(&JShaderCompilerStats::failed, start);
+		throw std::runtime_error("failed to compile shader " + source.filename + "!\n" + result.GetErrorMessage());
+	}
+	std::vector<uint32_t> code(result.cbegin(), result.cend());
+
+	writeCache(cacheKey, dependencies, code);
+	record(&JShaderCompilerStats::compiled, start);
+	return code;
+}
+
+std::vector<uint32_t> JShaderCompiler::compile(const JShaderSource& source)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::string text;
+	uint64_t cacheKey = readSource(source, text, start);
+
+	CacheEntry entry;
+	if (readCache(cacheKey, entry)) {
+		record(&JShaderCompilerStats::cacheHits, start);
+		return std::vector<uint32_t>(entry.code, entry.code + entry.codeSize);
+	}
+	return compileSource(source, text, cacheKey, start);
+}
+
+const JShaderModule* JShaderCompiler::load(const JShaderSource& source, JShaderCache* cache)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::string text;
+	uint64_t cacheKey = readSource(source, text, start);
+
+	CacheEntry entry;
+	if (readCache(cacheKey, entry)) {
+		record(&JShaderCompilerStats::cacheHits, start);
+		// from the mapping to the driver, it's unmapped once the module's made
+		return cache->get(source.type, entry.code, entry.codeSize * sizeof(uint32_t), source.entrypoint.c_str());
+	}
+	std::vector<uint32_t> code = compileSource(source, text, cacheKey, start);
+	return cache->get(source.type, code.data(), code.size() * sizeof(uint32_t), source.entrypoint.c_str());
+}
+
+std::vector<std::vector<uint32_t>> JShaderCompiler::compileAll(const std::vector<JShaderSource>& sources, JThreadPool* threads)
+{
+	std::vector<std::vector<uint32_t>> results(sources.size());
+	threads->parallelFor(static_cast<uint32_t>(sources.size()), [this, &sources, &results](uint32_t, uint32_t i) {
+		results[i] = compile(sources[i]);
+	});
+	return results;
+}
+
+std::vector<const JShaderModule*> JShaderCompiler::loadAll(const std::vector<JShaderSource>& sources, JShaderCache* cache, JThreadPool* threads)
+{
+	std::vector<const JShaderModule*> modules(sources.size(), nullptr);
+	threads->parallelFor(static_cast<uint32_t>(sources.size()), [this, &sources, cache, &modules](uint32_t, uint32_t i) {
+		modules[i] = load(sources[i], cache);
+	});
+	return modules;
+}
+
+JShaderCompilerStats JShaderCompiler::stats() const
+{
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	return _stats;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <shaderc/shaderc.hpp>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+#include "JShaderModule.h"
+#include "JShaderCache.h"
+#include "JMappedFile.h"
+#include "JThreadPool.h"
+
+// #define NAME VALUE for each entry, a map so the same set always comes out in the same order
+typedef std::map<std::string, std::string> JShaderDefines;
+
+// one GLSL file to compile, and the permutation of it (the defines)
+struct JShaderSource {
+	JShaderType type;
+	std::string filename;
+	JShaderDefines defines;
+	std::string entrypoint = "main";
+};
+
+struct JShaderCompilerStats {
+	uint32_t compiled = 0; // by shaderc
+	uint32_t cacheHits = 0; // read back from the cache directory, nothing compiled
+	uint32_t failed = 0;
+	double seconds = 0.0; // in compile() and load(), over every thread
+};
+
+// compiles GLSL to SPIR-V in process with shaderc, so running doesn't need shaders/compile.bat first
+// #include "..." is looked up next to the including file, then in the include directories, <...> only in those
+// every result goes in the cache directory, one file per permutation, keyed by the source, defines,
+// stage, entry point and the SPIR-V version shaderc targets, along with a hash of every file it included,
+// so a permutation is only compiled again when something that went into it changed
+// shaderc has no version of its own to ask for, so an upgrade that still targets the same SPIR-V version
+// isn't noticed, bump CACHE_VERSION along with the SDK
+// load() hands cache entries to the driver straight from a mapping of the file, nothing is copied
+// thread safe, compileAll() and loadAll() spread the work over a JThreadPool
+class JShaderCompiler
+{
+protected:
+	struct CacheHeader {
+		char magic[4]; // "JSPV"
+		uint32_t version;
+		uint64_t key;
+		uint32_t dependencyCount; // each one a uint32_t path length, the path, and a uint64_t hash of the file
+		uint32_t codeSize; // in words, after the dependencies padded to 4 bytes, so it's aligned in a mapping
+		uint64_t checksum; // fnv1a of everything after the header
+	};
+	static_assert(sizeof(CacheHeader) % sizeof(uint32_t) == 0, "the code after the header has to stay 4 byte aligned");
+	static const uint32_t CACHE_VERSION = 2;
+
+	// a file #included while compiling, and the hash of what was in it
+	struct Dependency {
+		std::string filename;
+		uint64_t hash;
+	};
+	class Includer;
+
+	// an entry that checked out, the code points into the mapping
+	struct CacheEntry {
+		std::unique_ptr<JMappedFile> file;
+		const uint32_t* code = nullptr;
+		uint32_t codeSize = 0; // in words
+	};
+
+	shaderc::Compiler _compiler;
+	std::string _cacheDirectory;
+	std::vector<std::string> _includeDirectories;
+	bool _optimize;
+
+	std::atomic<uint32_t> _temporaryCount{ 0 }; // so threads saving at once don't share a temporary file
+	mutable std::mutex _statsMutex;
+	JShaderCompilerStats _stats;
+
+	uint64_t key(const JShaderSource& source, const std::string& text) const;
+	std::string cacheFilename(uint64_t key) const;
+	// false if there's no entry, it's corrupt, or one of its includes changed
+	bool readCache(uint64_t key, CacheEntry& entry) const;
+	void writeCache(uint64_t key, const std::vector<Dependency>& dependencies, const std::vector<uint32_t>& code);
+
+	void record(uint32_t JShaderCompilerStats::* counter, std::chrono::steady_clock::time_point start);
+	// the source text and its key, throws if it can't be opened
+	uint64_t readSource(const JShaderSource& source, std::string& text, std::chrono::steady_clock::time_point start);
+	// with shaderc, for when the cache missed, saved to the cache afterwards
+	std::vector<uint32_t> compileSource(const JShaderSource& source, const std::string& text, uint64_t cacheKey,
+		std::chrono::steady_clock::time_point start);
+
+public:
+	JShaderCompiler() = delete;
+	JShaderCompiler(const JShaderCompiler&) = delete;
+	void operator=(const JShaderCompiler&) = delete;
+
+	// the cache directory is created if it isn't there
+	JShaderCompiler(const std::string& cacheDirectory, const std::vector<std::string>& includeDirectories = {}, bool optimize = true);
+
+	inline const std::string& cacheDirectory() const { return _cacheDirectory; }
+
+	// throws with shaderc's messages if it doesn't compile
+	std::vector<uint32_t> compile(const JShaderSource& source);
+	// the results in the same order as sources, throws the first failure once they've all been tried
+	std::vector<std::vector<uint32_t>> compileAll(const std::vector<JShaderSource>& sources, JThreadPool* threads);
+	// compile(), straight into a module from the shader cache, without copying the code out of the cache entry
+	const JShaderModule* load(const JShaderSource& source, JShaderCache* cache);
+	std::vector<const JShaderModule*> loadAll(const std::vector<JShaderSource>& sources, JShaderCache* cache, JThreadPool* threads);
+
+	JShaderCompilerStats stats() const;
+};
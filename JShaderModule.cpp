@@ -7,12 +7,23 @@
 
 
 //JShaderModule::JShaderModule(VkDevice device, JShaderType type, const std::vector<char>& code, const char* entrypoint) : device(device), _type(type), _entrypoint(entrypoint) {
-JShaderModule::JShaderModule(const JDevice* device, JShaderType type, const std::vector<char>& code, const char* entrypoint) : _pDevice(device), _type(type), _entrypoint(entrypoint) {
+JShaderModule::JShaderModule(const JDevice* device, JShaderType type, const std::vector<char>& code, const char* entrypoint) : JShaderModule(device, type, code.data(), code.size(), entrypoint) {
+	// vectors already satisfy the alignment requirements
+}
+
+JShaderModule::JShaderModule(const JDevice* device, JShaderType type, const void* code, size_t size, const char* entrypoint) : _pDevice(device), _type(type), _entrypoint(entrypoint) {
+	// the driver is the judge of whether the code is valid, reflection only matters to whoever asks for it
+	try {
+		_reflection = JShaderReflection::parse(code, size, flagBits(type));
+	}
+	catch (const std::exception& e) {
+		_reflectionError = e.what();
+	}
+
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); // needs to satisfy the alignment 
-	// requirements, but vectors already ensure that
+	createInfo.codeSize = size;
+	createInfo.pCode = static_cast<const uint32_t*>(code); // needs to satisfy the alignment requirements
 	
 	if (vkCreateShaderModule(_pDevice->device(), &createInfo, nullptr, &_module) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module!");
@@ -33,6 +44,14 @@ JShaderModule::~JShaderModule() {
 	vkDestroyShaderModule(_pDevice->device(), _module, nullptr);
 }
 
+const JShaderReflection& JShaderModule::reflection() const
+{
+	if (!_reflectionError.empty()) {
+		throw std::runtime_error("failed to reflect shader module: " + _reflectionError);
+	}
+	return _reflection;
+}
+
 VkPipelineShaderStageCreateInfo JShaderModule::stageInfo() const
 {
 	VkPipelineShaderStageCreateInfo info{};
@@ -41,8 +60,8 @@ VkPipelineShaderStageCreateInfo JShaderModule::stageInfo() const
 	info.stage = flagBits(_type); // vertex shader stage
 	info.module = module(); //vertShaderModule;
 	info.pName = _entrypoint; // entry point
-	// not usng pSpecializationInfo, but you can pass in compile time constants, and compiler can optimize 
-	// with these values, we're setting it to nullptr
+	// pSpecializationInfo is left nullptr, compile time constants go in through JPipelineBuilder::addStage
+	// with a JSpecializationConstants, which keeps them alive for as long as the pipeline's being built
 	return info;
 }
 
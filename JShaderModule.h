@@ -5,6 +5,7 @@
 #include <vector>
 #include <string>
 #include "JDevice.h"
+#include "JShaderReflection.h"
 
 enum JShaderType : uint32_t {
 	JVertex = 0x1, 
@@ -21,6 +22,10 @@ protected:
 	//VkDevice _device;
 	JShaderType _type;
 	const char* _entrypoint;
+	JShaderReflection _reflection;
+	// why the SPIR-V couldn't be reflected, empty if it could
+	// kept instead of thrown, so modules reflection can't make sense of still load, only reflection() throws
+	std::string _reflectionError;
 public:
 	//JShaderModule(const JDevice* device, JShaderType type, const char* fname, const char* entrypoint = "main");
 	//JShaderModule(VkDevice device, JShaderType type, const char* fname, const char* entrypoint = "main");
@@ -29,11 +34,17 @@ public:
 	JShaderModule(const JDevice* device, JShaderType type, const char* fname, const char* entrypoint = "main");
 	JShaderModule(const JDevice* device, JShaderType type, const std::vector<char>& code, const char* entrypoint = "main");
 	JShaderModule(const JDevice* device, JShaderType type, const std::string fname, const char* entrypoint = "main");
+	// code has to be 4 byte aligned, and is only read in here, so it can be a mapped file (see JShaderCache)
+	JShaderModule(const JDevice* device, JShaderType type, const void* code, size_t size, const char* entrypoint = "main");
 
 	JShaderModule() = delete;
 	JShaderModule(const JShaderModule& other) = delete;
 	virtual ~JShaderModule();
 	inline VkShaderModule module() const { return _module; }
+	// the descriptors, push constants and vertex inputs the SPIR-V uses, for making layouts (see JLayoutCache)
+	// throws if the SPIR-V couldn't be reflected
+	const JShaderReflection& reflection() const;
+	inline bool reflected() const { return _reflectionError.empty(); }
 	VkPipelineShaderStageCreateInfo stageInfo() const;
 };
 
@@ -0,0 +1,433 @@
+#include "JShaderReflection.h"
+
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+
+// the bits of the SPIR-V spec this needs
+namespace {
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const size_t SPIRV_HEADER_WORDS = 5;
+
+	enum Op : uint32_t {
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructureKHR = 5341,
+	};
+	enum Decoration : uint32_t {
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+	enum StorageClass : uint32_t {
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+	enum Dim : uint32_t {
+		DimBuffer = 5,
+		DimSubpassData = 6,
+	};
+
+	const uint32_t NONE = ~0u;
+
+	struct Decorations {
+		uint32_t set = NONE;
+		uint32_t binding = NONE;
+		uint32_t location = NONE;
+		uint32_t arrayStride = 0;
+		bool builtIn = false;
+		bool block = false;
+		bool bufferBlock = false;
+	};
+	struct MemberDecorations {
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+	};
+	struct Variable {
+		uint32_t type; // a pointer
+		uint32_t id;
+		uint32_t storageClass;
+	};
+
+	// everything parse() collects before it works out the bindings
+	struct Module {
+		// by result id, the operands without the opcode word, so operands[0] is the result id itself
+		std::unordered_map<uint32_t, std::pair<uint32_t, std::vector<uint32_t>>> types;
+		std::unordered_map<uint32_t, uint32_t> constants; // the low word, enough for array lengths
+		std::unordered_map<uint32_t, Decorations> decorations;
+		std::unordered_map<uint32_t, std::vector<MemberDecorations>> members;
+		std::vector<Variable> variables;
+
+		const std::pair<uint32_t, std::vector<uint32_t>>& type(uint32_t id) const {
+			auto found = types.find(id);
+			if (found == types.end()) {
+				throw std::runtime_error("invalid SPIR-V, unknown type!");
+			}
+			return found->second;
+		}
+		uint32_t constant(uint32_t id) const {
+			auto found = constants.find(id);
+			if (found == constants.end()) {
+				throw std::runtime_error("invalid SPIR-V, array length isn't a constant!");
+			}
+			return found->second;
+		}
+		Decorations decoration(uint32_t id) const {
+			auto found = decorations.find(id);
+			return found != decorations.end() ? found->second : Decorations{};
+		}
+		MemberDecorations member(uint32_t id, uint32_t index) const {
+			auto found = members.find(id);
+			return found != members.end() && index < found->second.size() ? found->second[index] : MemberDecorations{};
+		}
+
+		// the size of a type in a push constant block, from the offsets and strides it's decorated with
+		uint32_t size(uint32_t id, uint32_t matrixStride = 0) const {
+			const auto& t = type(id);
+			const std::vector<uint32_t>& operands = t.second;
+			switch (t.first) {
+			case OpTypeInt:
+			case OpTypeFloat:
+				return operands[1] / 8;
+			case OpTypeVector:
+				return operands[2] * size(operands[1]);
+			case OpTypeMatrix:
+				return operands[2] * (matrixStride != 0 ? matrixStride : size(operands[1]));
+			case OpTypeArray: {
+				uint32_t stride = decoration(id).arrayStride;
+				return constant(operands[2]) * (stride != 0 ? stride : size(operands[1]));
+			}
+			case OpTypeStruct: {
+				uint32_t end = 0;
+				for (uint32_t i = 1; i < operands.size(); ++i) {
+					MemberDecorations member = this->member(id, i - 1);
+					end = std::max(end, member.offset + size(operands[i], member.matrixStride));
+				}
+				return end;
+			}
+			default:
+				throw std::runtime_error("can't size this type in a push constant block!");
+			}
+		}
+	};
+
+	// how many operands (counting the result id) a type instruction needs for everything the reflection
+	// reads from it, shorter ones are rejected when they're recorded, so nothing past the end is read later
+	uint32_t minTypeOperands(uint32_t op)
+	{
+		switch (op) {
+		case OpTypeInt: return 3; // width, signedness
+		case OpTypeFloat: return 2; // width
+		case OpTypeVector: return 3; // component type, count
+		case OpTypeMatrix: return 3; // column type, count
+		case OpTypeImage: return 8; // sampled type, dim, depth, arrayed, multisampled, sampled, format
+		case OpTypeSampledImage: return 2; // image type
+		case OpTypeArray: return 3; // element type, length
+		case OpTypeRuntimeArray: return 2; // element type
+		case OpTypePointer: return 3; // storage class, type
+		default: return 1; // samplers, structs (members can be none), acceleration structures
+		}
+	}
+
+	VkDescriptorType descriptorType(const Module& module, uint32_t type, uint32_t storageClass)
+	{
+		const auto& t = module.type(type);
+		switch (t.first) {
+		case OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case OpTypeSampledImage:
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case OpTypeImage: {
+			uint32_t dim = t.second[2];
+			uint32_t sampled = t.second[6]; // 1 sampled, 2 storage
+			if (dim == DimBuffer) {
+				return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			if (dim == DimSubpassData) {
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		case OpTypeStruct:
+			// older SPIR-V has storage buffers as Uniform with BufferBlock
+			if (storageClass == StorageClassStorageBuffer || module.decoration(type).bufferBlock) {
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+			return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		default:
+			throw std::runtime_error("unsupported descriptor type in SPIR-V!");
+		}
+	}
+
+	VkFormat vertexFormat(const Module& module, uint32_t type)
+	{
+		static const VkFormat floats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat ints[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uints[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		const auto* t = &module.type(type);
+		uint32_t components = 1;
+		if (t->first == OpTypeVector) {
+			components = t->second[2];
+			t = &module.type(t->second[1]);
+		}
+		if ((t->first != OpTypeFloat && t->first != OpTypeInt) || components < 1 || components > 4 || t->second[1] != 32) {
+			return VK_FORMAT_UNDEFINED;
+		}
+		if (t->first == OpTypeFloat) {
+			return floats[components - 1];
+		}
+		if (t->first == OpTypeInt) {
+			return t->second[2] != 0 ? ints[components - 1] : uints[components - 1];
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+JShaderReflection JShaderReflection::parse(const void* code, size_t size, VkShaderStageFlagBits stage)
+{
+	if (size % sizeof(uint32_t) != 0 || size < SPIRV_HEADER_WORDS * sizeof(uint32_t)) {
+		throw std::runtime_error("invalid SPIR-V, wrong size!");
+	}
+	// copied, code doesn't have to be aligned
+	std::vector<uint32_t> words(size / sizeof(uint32_t));
+	memcpy(words.data(), code, size);
+	if (words[0] != SPIRV_MAGIC) {
+		throw std::runtime_error("invalid SPIR-V, bad magic number!");
+	}
+
+	Module module;
+	for (size_t i = SPIRV_HEADER_WORDS; i < words.size();) {
+		uint32_t op = words[i] & 0xffff;
+		uint32_t count = words[i] >> 16;
+		if (count == 0 || i + count > words.size()) {
+			throw std::runtime_error("invalid SPIR-V, bad instruction!");
+		}
+		const uint32_t* operands = &words[i + 1];
+		uint32_t operandCount = count - 1;
+
+		switch (op) {
+		case OpTypeInt:
+		case OpTypeFloat:
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeImage:
+		case OpTypeSampler:
+		case OpTypeSampledImage:
+		case OpTypeArray:
+		case OpTypeRuntimeArray:
+		case OpTypeStruct:
+		case OpTypePointer:
+		case OpTypeAccelerationStructureKHR:
+			if (operandCount < minTypeOperands(op)) {
+				throw std::runtime_error("invalid SPIR-V, type instruction is missing operands!");
+			}
+			module.types[operands[0]] = { op, std::vector<uint32_t>(operands, operands + operandCount) };
+			break;
+		case OpConstant:
+		case OpSpecConstant: // its default, the layout can't depend on specialization
+			if (operandCount >= 3) {
+				module.constants[operands[1]] = operands[2];
+			}
+			break;
+		case OpVariable:
+			if (operandCount >= 3) {
+				module.variables.push_back({ operands[0], operands[1], operands[2] });
+			}
+			break;
+		case OpDecorate:
+			if (operandCount >= 2) {
+				Decorations& decorations = module.decorations[operands[0]];
+				uint32_t value = operandCount >= 3 ? operands[2] : 0;
+				switch (operands[1]) {
+				case DecorationBlock: decorations.block = true; break;
+				case DecorationBufferBlock: decorations.bufferBlock = true; break;
+				case DecorationArrayStride: decorations.arrayStride = value; break;
+				case DecorationBuiltIn: decorations.builtIn = true; break;
+				case DecorationLocation: decorations.location = value; break;
+				case DecorationBinding: decorations.binding = value; break;
+				case DecorationDescriptorSet: decorations.set = value; break;
+				}
+			}
+			break;
+		case OpMemberDecorate:
+			if (operandCount >= 4) {
+				std::vector<MemberDecorations>& members = module.members[operands[0]];
+				if (members.size() <= operands[1]) {
+					members.resize(operands[1] + 1);
+				}
+				if (operands[2] == DecorationOffset) {
+					members[operands[1]].offset = operands[3];
+				}
+				else if (operands[2] == DecorationMatrixStride) {
+					members[operands[1]].matrixStride = operands[3];
+				}
+			}
+			break;
+		}
+		i += count;
+	}
+
+	JShaderReflection reflection;
+	reflection.stages = stage;
+	for (const Variable& variable : module.variables) {
+		const auto& pointer = module.type(variable.type);
+		if (pointer.first != OpTypePointer) {
+			throw std::runtime_error("invalid SPIR-V, variable isn't a pointer!");
+		}
+		uint32_t type = pointer.second[2];
+		Decorations decorations = module.decoration(variable.id);
+
+		switch (variable.storageClass) {
+		case StorageClassUniformConstant:
+		case StorageClassUniform:
+		case StorageClassStorageBuffer: {
+			if (decorations.set == NONE || decorations.binding == NONE) {
+				break;
+			}
+			uint32_t count = 1;
+			while (module.type(type).first == OpTypeArray) {
+				count *= module.constant(module.type(type).second[2]);
+				type = module.type(type).second[1];
+			}
+			if (module.type(type).first == OpTypeRuntimeArray) {
+				throw std::runtime_error("runtime descriptor arrays aren't supported!");
+			}
+			if (module.type(type).first == OpTypeAccelerationStructureKHR) {
+				throw std::runtime_error("acceleration structures aren't supported!");
+			}
+			JDescriptorBinding binding{};
+			binding.set = decorations.set;
+			binding.binding = decorations.binding;
+			binding.type = descriptorType(module, type, variable.storageClass);
+			binding.count = count;
+			binding.stages = stage;
+			reflection.bindings.push_back(binding);
+			break;
+		}
+		case StorageClassPushConstant: {
+			const auto& block = module.type(type);
+			uint32_t begin = NONE;
+			for (uint32_t m = 1; m < block.second.size(); ++m) {
+				begin = std::min(begin, module.member(type, m - 1).offset);
+			}
+			VkPushConstantRange range{};
+			range.stageFlags = stage;
+			range.offset = begin == NONE ? 0 : begin;
+			range.size = module.size(type) - range.offset;
+			reflection.pushConstants.push_back(range);
+			break;
+		}
+		case StorageClassInput:
+			if (stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn || decorations.location == NONE) {
+				break;
+			}
+			reflection.inputs.push_back({ decorations.location, vertexFormat(module, type) });
+			break;
+		}
+	}
+
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const JDescriptorBinding& a, const JDescriptorBinding& b) {
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+	std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const JVertexInput& a, const JVertexInput& b) {
+		return a.location < b.location;
+	});
+	return reflection;
+}
+
+void JShaderReflection::merge(const JShaderReflection& other)
+{
+	stages |= other.stages;
+	for (const JDescriptorBinding& binding : other.bindings) {
+		auto found = std::find_if(bindings.begin(), bindings.end(), [&binding](const JDescriptorBinding& b) {
+			return b.set == binding.set && b.binding == binding.binding;
+		});
+		if (found == bindings.end()) {
+			bindings.push_back(binding);
+			continue;
+		}
+		if (found->type != binding.type) {
+			throw std::runtime_error("descriptor binding used as two different types!");
+		}
+		found->count = std::max(found->count, binding.count);
+		found->stages |= binding.stages;
+	}
+	std::sort(bindings.begin(), bindings.end(), [](const JDescriptorBinding& a, const JDescriptorBinding& b) {
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	// stages that see the same range share it
+	for (const VkPushConstantRange& range : other.pushConstants) {
+		auto found = std::find_if(pushConstants.begin(), pushConstants.end(), [&range](const VkPushConstantRange& r) {
+			return r.offset == range.offset && r.size == range.size;
+		});
+		if (found != pushConstants.end()) {
+			found->stageFlags |= range.stageFlags;
+		}
+		else {
+			pushConstants.push_back(range);
+		}
+	}
+
+	inputs.insert(inputs.end(), other.inputs.begin(), other.inputs.end());
+	std::sort(inputs.begin(), inputs.end(), [](const JVertexInput& a, const JVertexInput& b) {
+		return a.location < b.location;
+	});
+}
+
+void JShaderReflection::makeDynamic(uint32_t set, uint32_t binding)
+{
+	for (JDescriptorBinding& b : bindings) {
+		if (b.set != set || b.binding != binding) {
+			continue;
+		}
+		if (b.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+			b.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			return;
+		}
+		if (b.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+			b.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+			return;
+		}
+		if (b.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || b.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+			return;
+		}
+		break;
+	}
+	throw std::runtime_error("no uniform or storage buffer to make dynamic!");
+}
+
+uint32_t JShaderReflection::setCount() const
+{
+	uint32_t count = 0;
+	for (const JDescriptorBinding& binding : bindings) {
+		count = std::max(count, binding.set + 1);
+	}
+	return count;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// a descriptor a shader uses, at layout(set = S, binding = B)
+struct JDescriptorBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count; // more than 1 for arrays of descriptors
+	VkShaderStageFlags stages;
+};
+
+// an in variable of a vertex shader, the format is VK_FORMAT_UNDEFINED for types there isn't one
+// obvious format for (matrices, 64 bit)
+struct JVertexInput {
+	uint32_t location;
+	VkFormat format;
+};
+
+// what a shader module needs from the pipeline layout and vertex input state, read out of its SPIR-V
+// covers every variable in the module, not just the ones one entry point uses
+// SPIR-V can't say a uniform or storage buffer is dynamic, that's up to how it's bound (see makeDynamic())
+struct JShaderReflection {
+	VkShaderStageFlags stages = 0;
+	std::vector<JDescriptorBinding> bindings; // sorted by set, then binding
+	std::vector<VkPushConstantRange> pushConstants; // one per stage at most
+	std::vector<JVertexInput> inputs; // only for vertex shaders, sorted by location
+
+	// throws if it isn't valid SPIR-V, or uses something the layouts can't describe (runtime descriptor arrays)
+	static JShaderReflection parse(const void* code, size_t size, VkShaderStageFlagBits stage);
+
+	// adds another stage's needs, so the pipeline's layout can be made from the result
+	// throws if the two use the same binding for different types of descriptor
+	void merge(const JShaderReflection& other);
+	// uniform and storage buffer bindings to their _DYNAMIC types, throws if there's no buffer at set, binding
+	void makeDynamic(uint32_t set, uint32_t binding);
+	// the number of descriptor sets the layout needs, highest set used plus one
+	uint32_t setCount() const;
+};
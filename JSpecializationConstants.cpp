@@ -0,0 +1,82 @@
+#include "JSpecializationConstants.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+JSpecializationConstants::JSpecializationConstants(const VkSpecializationInfo* info)
+{
+	if (info == nullptr) {
+		return;
+	}
+	const uint8_t* data = static_cast<const uint8_t*>(info->pData);
+	for (uint32_t i = 0; i < info->mapEntryCount; ++i) {
+		const VkSpecializationMapEntry& entry = info->pMapEntries[i];
+		if (entry.offset + entry.size > info->dataSize) {
+			throw std::runtime_error("specialization constant out of range!");
+		}
+		setBytes(entry.constantID, data + entry.offset, entry.size);
+	}
+}
+
+void JSpecializationConstants::setBytes(uint32_t id, const void* value, size_t size)
+{
+	// kept sorted by id, so the same values always hash the same
+	auto found = std::lower_bound(_entries.begin(), _entries.end(), id,
+		[](const VkSpecializationMapEntry& entry, uint32_t id) { return entry.constantID < id; });
+	if (found != _entries.end() && found->constantID == id) {
+		if (found->size != size) {
+			throw std::runtime_error("specialization constant set again with a different type!");
+		}
+		memcpy(_data.data() + found->offset, value, size);
+		return;
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = id;
+	entry.offset = static_cast<uint32_t>(_data.size());
+	entry.size = size;
+	_entries.insert(found, entry);
+	_data.insert(_data.end(), static_cast<const uint8_t*>(value), static_cast<const uint8_t*>(value) + size);
+}
+
+VkSpecializationInfo JSpecializationConstants::info() const
+{
+	VkSpecializationInfo info{};
+	info.mapEntryCount = static_cast<uint32_t>(_entries.size());
+	info.pMapEntries = _entries.data();
+	info.dataSize = _data.size();
+	info.pData = _data.data();
+	return info;
+}
+
+void JSpecializationConstants::appendIdentity(std::vector<uint8_t>& bytes) const
+{
+	auto add = [&bytes](const void* data, size_t size) {
+		bytes.insert(bytes.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	};
+	uint32_t count = static_cast<uint32_t>(_entries.size());
+	add(&count, sizeof(count));
+	for (const VkSpecializationMapEntry& entry : _entries) {
+		uint32_t size = static_cast<uint32_t>(entry.size);
+		add(&entry.constantID, sizeof(entry.constantID));
+		add(&size, sizeof(size));
+		add(_data.data() + entry.offset, entry.size);
+	}
+}
+
+bool JSpecializationConstants::operator==(const JSpecializationConstants& other) const
+{
+	if (_entries.size() != other._entries.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < _entries.size(); ++i) {
+		const VkSpecializationMapEntry& a = _entries[i];
+		const VkSpecializationMapEntry& b = other._entries[i];
+		if (a.constantID != b.constantID || a.size != b.size
+			|| memcmp(_data.data() + a.offset, other._data.data() + b.offset, a.size) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
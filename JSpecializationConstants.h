@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// values for a shader stage's specialization constants (layout(constant_id = N) const ... in glsl), so
+// things like light counts and shading toggles are compiled into the pipeline instead of branched on
+// bools are stored as VkBool32 like the spec wants, everything else as it is (int32, uint32, float, double)
+class JSpecializationConstants
+{
+protected:
+	std::vector<VkSpecializationMapEntry> _entries;
+	std::vector<uint8_t> _data;
+
+	void setBytes(uint32_t id, const void* value, size_t size);
+
+public:
+	JSpecializationConstants() = default;
+	// copies a VkSpecializationInfo that's already been filled in, nullptr gives an empty set
+	JSpecializationConstants(const VkSpecializationInfo* info);
+
+	inline bool empty() const { return _entries.empty(); }
+	inline size_t size() const { return _entries.size(); }
+
+	// replaces the value if id is already set
+	template<typename T>
+	JSpecializationConstants& set(uint32_t id, T value) {
+		static_assert(std::is_same<T, int32_t>::value || std::is_same<T, uint32_t>::value
+			|| std::is_same<T, float>::value || std::is_same<T, double>::value,
+			"specialization constants are bool, int32_t, uint32_t, float or double");
+		setBytes(id, &value, sizeof(value));
+		return *this;
+	}
+	inline JSpecializationConstants& set(uint32_t id, bool value) {
+		VkBool32 b = value ? VK_TRUE : VK_FALSE;
+		setBytes(id, &b, sizeof(b));
+		return *this;
+	}
+
+	// points into this object, so only valid while it's alive and unchanged
+	VkSpecializationInfo info() const;
+
+	// appends the ids and values to bytes, for telling pipelines apart (see JPipelineBuilder::identity)
+	// the order they were set in doesn't matter
+	void appendIdentity(std::vector<uint8_t>& bytes) const;
+
+	bool operator==(const JSpecializationConstants& other) const;
+	inline bool operator!=(const JSpecializationConstants& other) const { return !(*this == other); }
+};
@@ -0,0 +1,126 @@
+#include "JThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+
+JThreadPool::JThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		// hardware_concurrency can return 0 if it doesn't know
+		uint32_t cores = std::thread::hardware_concurrency();
+		threadCount = cores > 1 ? cores - 1 : 1;
+	}
+	_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		_workers.emplace_back(&JThreadPool::workerLoop, this, i);
+	}
+}
+
+JThreadPool::~JThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_taskAvailable.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+void JThreadPool::workerLoop(uint32_t worker)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_taskAvailable.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+		if (_tasks.empty()) {
+			return; // stopping, and nothing left to do
+		}
+		std::function<void(uint32_t)> task = std::move(_tasks.front());
+		_tasks.pop_front();
+		++_busy;
+
+		lock.unlock();
+		task(worker);
+		lock.lock();
+
+		--_busy;
+		if (_busy == 0 && _tasks.empty()) {
+			_idle.notify_all();
+		}
+	}
+}
+
+void JThreadPool::submit(std::function<void(uint32_t)> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(std::move(task));
+	}
+	_taskAvailable.notify_one();
+}
+
+void JThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _busy == 0 && _tasks.empty(); });
+}
+
+void JThreadPool::parallelFor(uint32_t chunkCount, const std::function<void(uint32_t, uint32_t)>& function)
+{
+	if (chunkCount == 0) {
+		return;
+	}
+
+	// shared, since helpers that only get to run after everything is done still look at it
+	struct State {
+		std::atomic<uint32_t> next{ 0 };
+		uint32_t done = 0;
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<State>();
+	const std::function<void(uint32_t, uint32_t)>* pFunction = &function; // only used while chunks are left
+
+	auto runChunks = [state, pFunction, chunkCount](uint32_t worker) {
+		uint32_t ran = 0;
+		std::exception_ptr error;
+		for (uint32_t chunk = state->next++; chunk < chunkCount; chunk = state->next++) {
+			try {
+				(*pFunction)(worker, chunk);
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+			++ran;
+		}
+		if (ran > 0) {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (error && !state->error) {
+				state->error = error;
+			}
+			state->done += ran;
+			if (state->done == chunkCount) {
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	// the caller takes chunks too, so one fewer helper than chunks is enough
+	uint32_t helpers = std::min(size(), chunkCount - 1);
+	for (uint32_t i = 0; i < helpers; ++i) {
+		submit(runChunks);
+	}
+	runChunks(callerIndex());
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, chunkCount]() { return state->done == chunkCount; });
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
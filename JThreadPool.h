@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+// fixed set of worker threads pulling tasks off one queue
+// tasks get the index of the worker running them (0 to size() - 1), so they can use per-thread
+// resources (command pools...) without locking
+// the thread that calls parallelFor helps out, and uses index size(), so per-thread resources
+// need size() + 1 slots (see slotCount())
+class JThreadPool
+{
+protected:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void(uint32_t)>> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _taskAvailable;
+	std::condition_variable _idle;
+	uint32_t _busy = 0; // workers currently running a task
+	bool _stopping = false;
+
+	void workerLoop(uint32_t worker);
+
+public:
+	JThreadPool(const JThreadPool&) = delete;
+	void operator=(const JThreadPool&) = delete;
+
+	// threadCount 0 means one per core, minus one for the thread that owns the pool
+	JThreadPool(uint32_t threadCount = 0);
+	// finishes the tasks that are already queued first
+	virtual ~JThreadPool();
+
+	inline uint32_t size() const { return static_cast<uint32_t>(_workers.size()); }
+	// workers plus the calling thread
+	inline uint32_t slotCount() const { return size() + 1; }
+	// index the calling thread gets in parallelFor
+	inline uint32_t callerIndex() const { return size(); }
+
+	// runs task(worker) on some worker, doesn't wait for it
+	// the task must not throw
+	void submit(std::function<void(uint32_t)> task);
+
+	// blocks until the queue is empty and every worker is idle
+	void wait();
+
+	// calls function(worker, chunk) for every chunk in [0, chunkCount), spread over the workers and
+	// the calling thread, and returns once they're all done
+	// chunks are handed out one at a time, so if the workers are busy with other tasks the caller just
+	// does more of them itself
+	// the first exception thrown by a chunk is rethrown here (the other chunks still run)
+	void parallelFor(uint32_t chunkCount, const std::function<void(uint32_t, uint32_t)>& function);
+};
+
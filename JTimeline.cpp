@@ -0,0 +1,65 @@
+#include "JTimeline.h"
+
+#include <stdexcept>
+
+
+JTimeline::JTimeline(const JDevice* device, uint64_t initialValue)
+	: _pDevice(device)
+	, _submitted(initialValue)
+	, _completed(initialValue)
+{
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = initialValue;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(_pDevice->device(), &semaphoreInfo, nullptr, &_semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+}
+
+JTimeline::~JTimeline()
+{
+	vkDestroySemaphore(_pDevice->device(), _semaphore, nullptr);
+}
+
+uint64_t JTimeline::completed() const
+{
+	uint64_t value;
+	if (vkGetSemaphoreCounterValue(_pDevice->device(), _semaphore, &value) != VK_SUCCESS) {
+		throw std::runtime_error("failed to get timeline semaphore value!");
+	}
+	// several threads might be updating it, keep the highest
+	uint64_t seen = _completed;
+	while (seen < value && !_completed.compare_exchange_weak(seen, value)) {
+	}
+	return value;
+}
+
+bool JTimeline::wait(uint64_t value, uint64_t timeout) const
+{
+	if (value <= _completed) {
+		return true;
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &_semaphore;
+	waitInfo.pValues = &value;
+	VkResult result = vkWaitSemaphores(_pDevice->device(), &waitInfo, timeout);
+	if (result == VK_TIMEOUT) {
+		return false;
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for timeline semaphore!");
+	}
+
+	uint64_t seen = _completed;
+	while (seen < value && !_completed.compare_exchange_weak(seen, value)) {
+	}
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+
+#include "JDevice.h"
+
+// one timeline semaphore counting everything submitted to the graphics queue
+// every submission signals the next value (from advance()), so "is the GPU done with X" is just
+// comparing the value X was submitted with against completed(), and waiting is vkWaitSemaphores
+// frames, uploads and deferred destruction all key off the same values
+// values are only ever signalled on one queue, in submission order, so they complete in order too
+// needs Vulkan 1.2 (or VK_KHR_timeline_semaphore) with the timelineSemaphore feature enabled
+class JTimeline
+{
+protected:
+	const JDevice* _pDevice;
+	VkSemaphore _semaphore = VK_NULL_HANDLE;
+	std::atomic<uint64_t> _submitted; // highest value handed out by advance()
+	mutable std::atomic<uint64_t> _completed; // highest value seen signalled, only ever grows
+
+public:
+	JTimeline() = delete;
+	JTimeline(const JTimeline&) = delete;
+	void operator=(const JTimeline&) = delete;
+
+	JTimeline(const JDevice* device, uint64_t initialValue = 0);
+	virtual ~JTimeline();
+
+	inline VkSemaphore semaphore() const { return _semaphore; }
+	inline uint64_t submitted() const { return _submitted; }
+
+	// the value the next submission should signal, call once per submission
+	inline uint64_t advance() { return ++_submitted; }
+
+	// the highest value the GPU has signalled, asks the driver
+	uint64_t completed() const;
+	// true once value has been signalled, only asks the driver if the last answer wasn't enough
+	inline bool reached(uint64_t value) const { return value <= _completed || value <= completed(); }
+
+	// blocks until value has been signalled, returns false on timeout
+	bool wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+	inline bool waitIdle() const { return wait(_submitted); }
+};
+
@@ -0,0 +1,382 @@
+#include "JUploadManager.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include "JImage.h"
+#include "vkutils.h"
+
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment; // the ring capacity doesn't have to be a power of 2
+}
+
+// what uploaded data gets used for, the second half of every batch's barrier
+static const VkAccessFlags UPLOAD_READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+	| VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+static const VkPipelineStageFlags UPLOAD_READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+JUploadManager::JUploadManager(const JDevice* device, const JCommandPool* pool, JTimeline* timeline, VkDeviceSize stagingSize)
+	: _pDevice(device)
+	, _pool(pool)
+	, _timeline(timeline)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_pDevice->physical(), &properties);
+	// buffer to image copies need offsets that are a multiple of 4 and of the texel size,
+	// 16 covers every uncompressed format and block compressed formats
+	_alignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 16);
+	_capacity = alignUp(stagingSize, _alignment);
+
+	_staging = new JBuffer(
+		_pDevice,
+		_capacity,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// copies on a DMA queue run alongside rendering instead of in between frames
+	if (_pDevice->hasDedicatedTransfer() && _pDevice->queueFamily(JQueueType::JTransferQueue) != _pool->queueFamily()) {
+		_transferPool = new JCommandPool(_pDevice,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, JQueueType::JTransferQueue);
+	}
+
+	_current.ticket = 1;
+}
+
+JUploadManager::~JUploadManager()
+{
+	waitIdle();
+	for (VkSemaphore semaphore : _freeSemaphores) {
+		vkDestroySemaphore(_pDevice->device(), semaphore, nullptr);
+	}
+	delete _staging; _staging = nullptr;
+	delete _transferPool; _transferPool = nullptr;
+}
+
+VkCommandBuffer JUploadManager::allocateCommandBuffer(const JCommandPool* pool)
+{
+	// recycled from earlier batches once the pool has some free
+	VkCommandBuffer cmd = pool->acquire();
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(cmd, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording upload command buffer!");
+	}
+	return cmd;
+}
+
+VkCommandBuffer JUploadManager::currentCommandBuffer()
+{
+	if (_current.cmd == VK_NULL_HANDLE) {
+		_current.cmd = allocateCommandBuffer(copyPool());
+	}
+	return _current.cmd;
+}
+
+void JUploadManager::allocateStaging(VkDeviceSize size, JBuffer** buffer, VkDeviceSize* offset)
+{
+	VkDeviceSize aligned = alignUp(size, _alignment);
+
+	// huge uploads would have to drain the whole ring, give them their own staging buffer instead
+	// it's freed along with the batch
+	if (aligned > _capacity / 2) {
+		*buffer = new JBuffer(
+			_pDevice,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		_current.oversized.push_back(*buffer);
+		*offset = 0;
+		return;
+	}
+
+	uint64_t start;
+	for (;;) {
+		if (_tail == _head) {
+			// nothing's in use, start again at the beginning of the buffer
+			_head = _tail = alignUp(_head, _capacity);
+		}
+		start = alignUp(_head, _alignment);
+		// allocations never wrap around the end of the buffer, skip to the start instead
+		if (start % _capacity + aligned > _capacity) {
+			start = alignUp(start, _capacity);
+		}
+		if (start + aligned - _tail <= _capacity) {
+			break;
+		}
+		// full, free up space by waiting for the oldest batch
+		// if there's nothing in flight, the current batch is using the whole ring, so send it off first
+		if (_inFlight.empty()) {
+			submit();
+		}
+		else {
+			waitOldest();
+		}
+	}
+
+	_head = start + aligned;
+	*buffer = _staging;
+	*offset = start % _capacity;
+}
+
+void JUploadManager::upload(const JBuffer* dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+	if (size == 0) {
+		return;
+	}
+	if (dstOffset + size > dst->size()) {
+		throw std::runtime_error("upload out of range for buffer!");
+	}
+
+	JBuffer* staging;
+	VkDeviceSize stagingOffset;
+	allocateStaging(size, &staging, &stagingOffset);
+	staging->write(data, size, stagingOffset);
+
+	VkBufferCopy region{};
+	region.srcOffset = stagingOffset;
+	region.dstOffset = dstOffset;
+	region.size = size;
+	vkCmdCopyBuffer(currentCommandBuffer(), staging->buffer(), dst->buffer(), 1, &region);
+
+	// on one queue the global barrier at the end of the batch covers buffers, only ownership
+	// transfers need to name them
+	if (_transferPool) {
+		_bufferBarriers.push_back(bufferOwnershipBarrier(dst->buffer(), dstOffset, size,
+			_transferPool->queueFamily(), _pool->queueFamily(), VK_ACCESS_TRANSFER_WRITE_BIT, UPLOAD_READ_ACCESS));
+	}
+}
+
+void JUploadManager::upload(JImage* dst, const void* pixels, VkDeviceSize size, VkImageLayout finalLayout)
+{
+	JBuffer* staging;
+	VkDeviceSize stagingOffset;
+	allocateStaging(size, &staging, &stagingOffset);
+	staging->write(pixels, size, stagingOffset);
+
+	VkCommandBuffer cmd = currentCommandBuffer();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // throw away the old contents
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst->image();
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0,0,0 };
+	region.imageExtent = { dst->width(), dst->height(), 1 };
+	vkCmdCopyBufferToImage(cmd, staging->buffer(), dst->image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// the move to finalLayout happens in the barrier at the end of the batch, along with everything else
+	_finalBarriers.push_back(imageOwnershipBarrier(dst->image(), barrier.subresourceRange,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout,
+		copyPool()->queueFamily(), _pool->queueFamily(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+
+	dst->_layout = finalLayout;
+}
+
+JUploadTicket JUploadManager::submit()
+{
+	if (_current.cmd == VK_NULL_HANDLE) {
+		return _current.ticket - 1; // nothing recorded
+	}
+
+	if (_transferPool == nullptr) {
+		// one barrier for the whole batch, makes every copy visible to whatever reads it next on this queue
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = UPLOAD_READ_ACCESS;
+		vkCmdPipelineBarrier(
+			_current.cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			UPLOAD_READ_STAGES,
+			0,
+			1, &barrier,
+			0, nullptr,
+			static_cast<uint32_t>(_finalBarriers.size()), _finalBarriers.data());
+	}
+	else {
+		// release everything to the graphics family, the transfer queue doesn't know the read stages
+		std::vector<VkBufferMemoryBarrier> bufferBarriers = _bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers = _finalBarriers;
+		for (auto& barrier : bufferBarriers) {
+			barrier.dstAccessMask = 0;
+		}
+		for (auto& barrier : imageBarriers) {
+			barrier.dstAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(
+			_current.cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	if (vkEndCommandBuffer(_current.cmd) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+
+	// whichever submission goes on _pool's queue signals the timeline
+	VkSemaphore timelineSemaphore = _timeline->semaphore();
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &_current.timelineValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &_current.cmd;
+
+	if (_transferPool == nullptr) {
+		_current.timelineValue = _timeline->advance();
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timelineSemaphore;
+		if (vkQueueSubmit(_pool->queue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit uploads!");
+		}
+	}
+	else {
+		if (_freeSemaphores.empty()) {
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			VkSemaphore semaphore;
+			if (vkCreateSemaphore(_pDevice->device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+			_freeSemaphores.push_back(semaphore);
+		}
+		_current.semaphore = _freeSemaphores.back();
+		_freeSemaphores.pop_back();
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &_current.semaphore;
+		if (vkQueueSubmit(_transferPool->queue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit uploads!");
+		}
+
+		// the acquiring half, on the queue that uses the resources
+		// it waits for the copies with the semaphore, everything submitted after it on that queue
+		// is ordered behind its barrier
+		_current.acquireCmd = allocateCommandBuffer(_pool);
+		for (auto& barrier : _bufferBarriers) {
+			barrier.srcAccessMask = 0;
+		}
+		for (auto& barrier : _finalBarriers) {
+			barrier.srcAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(
+			_current.acquireCmd,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // chains with the semaphore wait
+			UPLOAD_READ_STAGES,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(_bufferBarriers.size()), _bufferBarriers.data(),
+			static_cast<uint32_t>(_finalBarriers.size()), _finalBarriers.data());
+		if (vkEndCommandBuffer(_current.acquireCmd) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload acquire command buffer!");
+		}
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquireInfo{};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &_current.semaphore;
+		acquireInfo.pWaitDstStageMask = &waitStage;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &_current.acquireCmd;
+		// the timeline is signalled by the acquire, which can't finish before the copies
+		// (the wait is on a binary semaphore, so it doesn't need a value)
+		_current.timelineValue = _timeline->advance();
+		acquireInfo.pNext = &timelineInfo;
+		acquireInfo.signalSemaphoreCount = 1;
+		acquireInfo.pSignalSemaphores = &timelineSemaphore;
+		if (vkQueueSubmit(_pool->queue(), 1, &acquireInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload acquire!");
+		}
+	}
+	_bufferBarriers.clear();
+	_finalBarriers.clear();
+
+	JUploadTicket ticket = _current.ticket;
+	_current.stagingEnd = _head; // everything allocated so far is done once this batch is
+	_inFlight.push_back(std::move(_current));
+
+	_current = Batch{};
+	_current.ticket = ticket + 1;
+	return ticket;
+}
+
+void JUploadManager::retire(Batch& batch)
+{
+	copyPool()->release(1, &batch.cmd);
+	if (batch.acquireCmd != VK_NULL_HANDLE) {
+		_pool->release(1, &batch.acquireCmd);
+	}
+	if (batch.semaphore != VK_NULL_HANDLE) {
+		_freeSemaphores.push_back(batch.semaphore);
+	}
+	for (JBuffer* buffer : batch.oversized) {
+		delete buffer;
+	}
+	_tail = std::max(_tail, batch.stagingEnd);
+	_completed = batch.ticket;
+}
+
+void JUploadManager::waitOldest()
+{
+	Batch& oldest = _inFlight.front();
+	_timeline->wait(oldest.timelineValue);
+	retire(oldest);
+	_inFlight.pop_front();
+}
+
+void JUploadManager::collect()
+{
+	// batches signal increasing values on the same timeline, so they finish in order
+	while (!_inFlight.empty() && _timeline->reached(_inFlight.front().timelineValue)) {
+		retire(_inFlight.front());
+		_inFlight.pop_front();
+	}
+}
+
+bool JUploadManager::isComplete(JUploadTicket ticket)
+{
+	collect();
+	return ticket <= _completed;
+}
+
+void JUploadManager::wait(JUploadTicket ticket)
+{
+	if (ticket >= _current.ticket) {
+		submit();
+	}
+	while (_completed < ticket && !_inFlight.empty()) {
+		waitOldest();
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+
+#include "JDevice.h"
+#include "JCommandPool.h"
+#include "JBuffer.h"
+#include "JTimeline.h"
+
+class JImage;
+
+// identifies a batch of uploads, larger tickets are submitted later
+// 0 is never a real ticket, so it can mean "nothing to wait for"
+typedef uint64_t JUploadTicket;
+
+// batches buffer and image uploads into one command buffer instead of submitting and
+// waiting on the queue for every copy
+// data is copied into a persistently mapped staging ring, the copies are recorded into the
+// current batch, and submit() sends the whole batch off, signalling the next value of the timeline
+// staging space is handed back once the timeline reaches the value of the batch that used it
+// each batch ends with a barrier making the copies visible to vertex input and shaders, so
+// anything submitted to the same queue afterwards can use the data without the CPU waiting
+// if the device has a dedicated transfer queue, the copies run there instead, and ownership of
+// the resources is released to pool's queue family, which acquires it in a small command buffer
+// of its own (waiting on the copies with a semaphore)
+// not thread safe
+class JUploadManager
+{
+protected:
+	struct Batch {
+		VkCommandBuffer cmd = VK_NULL_HANDLE; // the copies, from copyPool()
+		VkCommandBuffer acquireCmd = VK_NULL_HANDLE; // ownership acquires, from _pool, only when using the transfer queue
+		VkSemaphore semaphore = VK_NULL_HANDLE; // copies -> acquire, only when using the transfer queue
+		uint64_t timelineValue = 0; // signalled on _pool's queue once the batch is done
+		JUploadTicket ticket = 0;
+		uint64_t stagingEnd = 0; // ring position the staging space is freed up to once this batch is done
+		std::vector<JBuffer*> oversized; // dedicated staging for uploads too big for the ring
+	};
+
+	const JDevice* _pDevice;
+	const JCommandPool* _pool; // the queue the uploaded resources are used on
+	JTimeline* _timeline;
+	JCommandPool* _transferPool = nullptr; // dedicated transfer queue, nullptr if the copies go on _pool's queue
+
+	JBuffer* _staging = nullptr;
+	VkDeviceSize _capacity;
+	VkDeviceSize _alignment; // every staging allocation starts on this, good enough for any texel format
+	// positions in the ring only ever grow, position % _capacity is the offset in the buffer
+	uint64_t _head = 0; // next free byte
+	uint64_t _tail = 0; // oldest byte still in use by the GPU
+
+	Batch _current; // being recorded, cmd is VK_NULL_HANDLE if nothing's been recorded yet
+	// ownership transfers (if any) and image layout transitions to do at the end of _current,
+	// with the access masks of both halves
+	std::vector<VkBufferMemoryBarrier> _bufferBarriers;
+	std::vector<VkImageMemoryBarrier> _finalBarriers;
+	std::deque<Batch> _inFlight; // submitted, oldest first
+	std::vector<VkSemaphore> _freeSemaphores;
+
+	JUploadTicket _completed = 0; // every ticket up to this one is done
+
+	inline const JCommandPool* copyPool() const { return _transferPool ? _transferPool : _pool; }
+	VkCommandBuffer allocateCommandBuffer(const JCommandPool* pool);
+	VkCommandBuffer currentCommandBuffer();
+	// reserves size bytes of staging, returns the buffer and offset to write and copy from
+	// waits on (or submits) earlier batches if the ring is full
+	void allocateStaging(VkDeviceSize size, JBuffer** buffer, VkDeviceSize* offset);
+	void retire(Batch& batch);
+	void waitOldest();
+
+public:
+	JUploadManager() = delete;
+	JUploadManager(const JUploadManager&) = delete;
+	void operator=(const JUploadManager&) = delete;
+
+	// pool is for the queue that will use the uploads (normally graphics), it should be resettable
+	// so command buffers from finished batches get reused
+	// the copies go on the device's dedicated transfer queue if it has one, otherwise on pool's queue
+	// every batch signals timeline on pool's queue, so it has to be the queue timeline is signalled on
+	JUploadManager(const JDevice* device, const JCommandPool* pool, JTimeline* timeline, VkDeviceSize stagingSize = 32 * 1024 * 1024);
+	virtual ~JUploadManager();
+
+	inline const JCommandPool* pool() const { return _pool; }
+	inline bool usesTransferQueue() const { return _transferPool != nullptr; }
+	// the ticket uploads recorded now will be part of
+	inline JUploadTicket currentTicket() const { return _current.ticket; }
+	inline JUploadTicket completedTicket() const { return _completed; }
+
+	// copies size bytes of data to dst at dstOffset
+	void upload(const JBuffer* dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+	template<typename T>
+	inline void upload(const JBuffer* dst, const std::vector<T>& values, VkDeviceSize dstOffset = 0) {
+		upload(dst, values.data(), sizeof(T) * values.size(), dstOffset);
+	}
+
+	// copies tightly packed pixels into the whole image, leaving it in finalLayout
+	// the image's previous contents are discarded
+	void upload(JImage* dst, const void* pixels, VkDeviceSize size, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// submits everything recorded so far, returns its ticket (or the last ticket if nothing was recorded)
+	JUploadTicket submit();
+
+	// recycles the staging space and command buffers of finished batches, call once in a while
+	void collect();
+	// true once the batch with ticket is done on the GPU, never blocks
+	bool isComplete(JUploadTicket ticket);
+	// blocks until the batch with ticket is done, submitting it first if needed
+	void wait(JUploadTicket ticket);
+	// submits and waits for everything
+	inline void waitIdle() { wait(submit()); }
+};
+
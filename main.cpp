@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <iostream>
+#include <fstream>
+#include <mutex>
 #include <vector>
 #include <array>
 #include <map>
@@ -26,6 +28,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+#include <deque>
 
 // stb image library
 // implementation in this file
@@ -41,10 +44,58 @@
 #include "JCommandPool.h"
 #include "JCommandBuffer.h"
 #include "JImage.h"
+#include "JFrameAllocator.h"
+#include "JUploadManager.h"
+#include "JMemoryAllocator.h"
+#include "JResourceTable.h"
+#include "JDeletionQueue.h"
+#include "JThreadPool.h"
+#include "JParallelRecorder.h"
+#include "JDrawList.h"
+#include "JCommandRecorder.h"
+#include "JDrawQueue.h"
+#include "JTimeline.h"
+#include "JConfig.h"
+#include "JLatencyStats.h"
+#include "JPipelineBuilder.h"
+#include "JPipelineCache.h"
+#include "JPipelineManager.h"
+#include "JSpecializationConstants.h"
+#include "JShaderCache.h"
+#include "JShaderCompiler.h"
+#include "JLayoutCache.h"
+#include "JMemoryTypeTests.h"
+#include "JAllocatorBenchmark.h"
 
 const constexpr uint32_t WIDTH = 800;
 const constexpr uint32_t HEIGHT = 600;
-const constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+// per frame in flight, for uniforms and any other data that's rewritten every frame
+const constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 4 * 1024 * 1024;
+// draws per secondary command buffer when recording on several threads, a frame with fewer than
+// twice this is recorded inline on the main thread
+const constexpr uint32_t PARALLEL_RECORD_CHUNK = 256;
+
+// memory stats get appended to this file (one json object per line) every so often, for spotting leaks
+// and budget overruns in long sessions
+const char* const MEMORY_STATS_FILE = "memory_stats.jsonl";
+const constexpr double MEMORY_STATS_INTERVAL = 10.0; // seconds
+
+// compiled pipelines, loaded at startup and saved at shutdown (see JPipelineCache)
+const char* const PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+// the shaders are compiled from glsl at startup, into this directory, so only the ones that changed
+// since the last run are actually compiled (see JShaderCompiler)
+const char* const SHADER_CACHE_DIR = "shader_cache";
+
+// specialization constants for shader.frag, compiled into the pipeline rather than branched on
+const constexpr int32_t MAX_LIGHTS = 4; // the size of shader.frag's lightPos
+const constexpr int32_t LIGHT_COUNT = 1;
+static_assert(LIGHT_COUNT >= 0 && LIGHT_COUNT <= MAX_LIGHTS, "shader.frag only has MAX_LIGHTS light positions");
+const constexpr bool LIGHTING = true;
+const constexpr float AMBIENT = 0.1f;
+
+// read at startup if it's there, before the command line (see JConfig for what can go in it)
+const char* const CONFIG_FILE = "config.txt";
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -182,15 +233,22 @@ struct UniformBufferObject {
 
 class HelloTriangleApplication {
 public:
-	void run() {
+	void run(const JConfig& settings) {
+		config = settings;
 		initWindow();
 		initModel();
 		initVulkan();
-		mainLoop();
+		if (config.mode == JRunMode::JApp) {
+			mainLoop();
+		}
+		else {
+			runBenchmark();
+		}
 		cleanup();
 	}
 private:
 	// data members
+	JConfig config; // frames in flight, present modes, low latency mode
 	GLFWwindow* window; // window ptr
 	VkInstance instance; // Instance handle
 	VkDebugUtilsMessengerEXT debugMessenger; // handle for debug callback
@@ -206,7 +264,7 @@ private:
 	JDevice* device;
 
 	// swapchain stuff
-	VkSwapchainKHR swapChain;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
@@ -217,39 +275,107 @@ private:
 	// render passes 
 	VkRenderPass renderPass;
 	// pipeline stuff
+	JLayoutCache* layoutCache = nullptr; // owns the two layouts below
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline; 
+	VkPipeline graphicsPipeline = VK_NULL_HANDLE; // what this frame draws with, resolved from the keys below every frame
+	JPipelineCache* pipelineCache = nullptr; // every pipeline is created through it
+	JPipelineManager* pipelines = nullptr; // compiles variants on threadPool, owns every pipeline
+	uint64_t graphicsPipelineKey = 0; // the variant the draws want
+	uint64_t fallbackPipelineKey = 0; // one to draw with until that's ready, 0 to skip the draws
+	VkRenderPass graphicsPipelineRenderPass = VK_NULL_HANDLE; // the key's variant is for this render pass
+	JShaderCompiler* shaderCompiler = nullptr;
+	JShaderCache* shaderCache = nullptr; // owns the modules, kept for as long as variants might be compiled from them
+	const JShaderModule* vertModule = nullptr;
+	const JShaderModule* fragModule = nullptr;
+	// cull mode, front face, topology and depth state, left to the command buffer if the pipeline
+	// has them dynamic (graphicsPipelineDynamicRaster), so changing them doesn't need another pipeline
+	JRasterState rasterState;
+	bool graphicsPipelineDynamicRaster = false;
 
 	// framebuffers
 	std::vector<VkFramebuffer> swapChainFramebuffers;
+	VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR; // the one picked from config.presentModes
 
 	// command pools and buffers
 	//VkCommandPool commandPool;
-	JCommandPool* commandPool;
-	JCommandPool* transientPool;
+	std::vector<JCommandPool*> framePools; // one per frame in flight, reset wholesale once the timeline passes the frame
+	JCommandPool* transientPool; // one-shot commands, its buffers are recycled
+	JUploadManager* uploads = nullptr; // batches the staging copies for vertex/index buffers and textures
 	
-	JCommandBuffers* commandBuffers;
 	//std::vector<VkCommandBuffer> commandBuffers;
 
 	// descriptor pool
 	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	VkDescriptorSet descriptorSet; // one set for everything, the uniform ring is bound with dynamic offsets
 
 	// drawing stuff
+	// the swap chain only works with binary semaphores, everything else waits on the timeline
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
 	size_t currentFrame = 0;
 
+	// every graphics queue submission (frames and uploads) signals the next value of the timeline,
+	// things are destroyed once it reaches the value of the last submission that might use them
+	JTimeline* timeline = nullptr;
+	std::vector<uint64_t> frameValues; // timeline value each frame in flight last signalled
+	std::vector<uint64_t> imageValues; // timeline value of the last frame that rendered to each swap chain image
+	uint64_t lastFrameValue = 0; // timeline value of the last frame submitted, low latency mode waits on it
+	JDeletionQueue deletionQueue;
+
+	// latency from sampling input (events polled, and the time the frame animates to, once per frame in mainLoop)
+	// to two points, neither of which is the image reaching the screen, there's no timing for that without
+	// extensions (VK_GOOGLE_display_timing, VK_KHR_present_wait):
+	// present, when vkQueuePresentKHR returns, i.e. the frame's been handed to the presentation engine
+	// gpu completion, when the timeline shows the GPU has finished the frame, which is only checked once a
+	// frame, so it's observed up to a frame late
+	std::chrono::steady_clock::time_point inputTime;
+	std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> pendingGpuLatency; // frame value, input time
+	JLatencyStats presentLatency; // reset every time they're written
+	JLatencyStats gpuLatency;
+
 	bool framebufferResized = false;
 
+	// buffers and images live by value in these, everything else refers to them by handle
+	JResourceTable<JBuffer> buffers;
+	JResourceTable<JImage> images;
+
 	// vertex buffer
-	JBuffer* vertBuffer = nullptr;
-	JBuffer* indexBuffer = nullptr;
+	JHandle<JBuffer> vertBuffer;
+	JHandle<JBuffer> indexBuffer;
 	
-	std::vector<JBuffer*> uniformBuffers; // need a uniform buffer for each swap chain image
+	JFrameAllocator* frameAllocator = nullptr; // every frame's transient data (uniforms...), reset per frame in flight
+
+	JThreadPool* threadPool = nullptr;
+	JParallelRecorder* recorder = nullptr; // records big draw lists into secondary buffers on threadPool
+	JDrawQueue drawQueue; // this frame's draws with their sort keys, before they're sorted into drawList
+	JDrawList drawList; // this frame's draws, rebuilt every frame
+
+	// camera, the draw sort keys need it for depth too
+	glm::vec3 cameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
+	glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 10.0f;
+
+	// what a frame in flight's command buffers were recorded from, they're reused until any of it changes
+	struct FrameRecording {
+		bool valid = false;
+		uint64_t drawListVersion = 0;
+		uint64_t swapChainGeneration = 0;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		JRasterState rasterState; // only recorded into the buffers when it's dynamic, but cheap to compare
+		uint32_t uniformBase = 0;
+		std::vector<VkCommandBuffer> imageBuffers; // by swap chain image, VK_NULL_HANDLE until recorded
+	};
+	std::vector<FrameRecording> frameRecordings; // one per frame in flight
+	uint64_t swapChainGeneration = 0; // bumped whenever the swap chain (and its framebuffers) are recreated
+
+	// recording cost, reset every time it's printed
+	uint64_t framesRecorded = 0;
+	uint64_t framesReused = 0;
+	double recordSeconds = 0.0;
+	JRecordStats recordStats; // binds issued and elided, summed over every recorder
+	std::mutex recordStatsMutex;
 
 	std::vector<Vertex> vertices = {
 	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
@@ -265,7 +391,7 @@ private:
 
 	// texture image
 
-	JImage* textureImage;
+	JHandle<JImage> textureImage;
 	
 	//VkBuffer vertexBuffer;
 	//VkDeviceMemory vertexBufferMemory;
@@ -351,20 +477,29 @@ private:
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
-		createSwapChain();
+		createPipelineCache();
+		createThreadPool();
+		createPipelineManager();
+		createSwapChain(VK_NULL_HANDLE);
 		createImageViews();
 		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
+		createShaderModules();
+		createLayouts();
+		createGraphicsPipeline(); // only asks for it, it's compiled while the rest is set up
 		createFramebuffers();
 		createCommandPool();
+		createTimeline();
+		createUploadManager();
 		createTextureImage();
 		createVertexBuffer();
 		createIndexBuffer();
-		createUniformBuffers();
+		// send off all the uploads in one go, nothing waits for them, the upload batch ends
+		// with a barrier that makes the data visible to the draws submitted after it
+		uploads->submit();
+		createFrameAllocator();
+		createRecorder();
 		createDescriptorPool();
 		createDescriptorSets();
-		createCommandBuffers();
 		createSyncObjects();
 	}
 	void createInstance() {
@@ -378,7 +513,7 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_2; // 1.2 for timeline semaphores (and 1.1 for the memory budget)
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -563,6 +698,10 @@ private:
 			return 0; // can't use if we don't have adequate swap chain support
 		}
 
+		if (!supportsTimelineSemaphores(device)) {
+			return 0; // all the CPU-GPU sync goes through the timeline
+		}
+
 		return score;
 
 		// example stuff
@@ -588,10 +727,12 @@ private:
 		// eh whatever, first is probably fine if the preferred is not available
 		return availableFormats[0];
 	}
+	// the first of the configured present modes that's available (IMMEDIATE for the lowest latency,
+	// MAILBOX for triple buffering...)
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		for (const auto& presentMode : availablePresentModes) {
-			if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) { // used for triple buffering
-				return presentMode;
+		for (VkPresentModeKHR preferred : config.presentModes) {
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferred) != availablePresentModes.end()) {
+				return preferred;
 			}
 		}
 
@@ -628,11 +769,14 @@ private:
 		device = new JDevice(physicalDevice, surface, deviceExtensions, enableValidationLayers, validationLayers);
 	}
 
-	void createSwapChain() {
+	// oldSwapChain is the one being replaced (or VK_NULL_HANDLE), which lets the driver hand its resources
+	// over, and keeps it presentable until the new one is in use, it still has to be destroyed afterwards
+	void createSwapChain(VkSwapchainKHR oldSwapChain) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface);
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+		swapChainPresentMode = presentMode;
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
 		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -676,7 +820,7 @@ private:
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE; // don't care about color of obscured pixels.
 
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		createInfo.oldSwapchain = oldSwapChain;
 
 		if (vkCreateSwapchainKHR(device->device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
@@ -787,43 +931,182 @@ private:
 		}
 	}
 
-	void createDescriptorSetLayout() {
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0; // same as in shader
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // type of resource 
-		// descriptor
-		uboLayoutBinding.descriptorCount = 1;
-		// we are allowed to have an array of UBOS, descriptor count specifies the number of values in
-		// the array.
-		// e.g., could have a transformation for each bone in a skeletal animation, for example.
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		// used in vertex shader, can be a combination of the shader stage values or 
-		// SHADER_STAGE_ALL_GRAPHICS
-		uboLayoutBinding.pImmutableSamplers = nullptr; // optional, only relevant for image 
-		// sampling related descriptors,
-		// later in tutorial
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding; // takes an array of layout bindings
-		if (vkCreateDescriptorSetLayout(device->device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor set layout!");
+	void createPipelineCache() {
+		pipelineCache = new JPipelineCache(device, PIPELINE_CACHE_FILE);
+	}
+
+	void createThreadPool() {
+		threadPool = new JThreadPool();
+	}
+
+	void createPipelineManager() {
+		pipelines = new JPipelineManager(device, pipelineCache, threadPool);
+	}
+
+	// the benchmarks that need a device, they print their results instead of opening the window's main loop
+	void runBenchmark() {
+		if (config.mode == JRunMode::JBenchAllocator) {
+			JAllocatorBenchmark benchmark(device, std::cout);
+			benchmark.run();
+		}
+		else if (config.mode == JRunMode::JBenchRecording) {
+			benchmarkRecording();
+		}
+		vkDeviceWaitIdle(device->device());
+	}
+
+	// begins commandBuffer and the render pass on the first framebuffer, for benchmarkRecording
+	void beginBenchmarkPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
 		}
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = swapChainFramebuffers[0];
+		renderPassInfo.renderArea.offset = { 0,0 };
+		renderPassInfo.renderArea.extent = swapChainExtent;
+		VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
 	}
 
+	// how recording scales with cores: BENCHMARK_DRAWS draws recorded inline on this thread, then through a
+	// JParallelRecorder with 1 worker plus this thread, 2 workers, and so on up to one per core
+	// nothing is submitted, each time is the average of BENCHMARK_REPEATS recordings
+	void benchmarkRecording() {
+		const size_t BENCHMARK_DRAWS = 10000;
+		const uint32_t BENCHMARK_REPEATS = 20;
+
+		graphicsPipeline = pipelines->wait(graphicsPipelineKey);
+		buildDrawList();
+		JDraw draw = drawList[0];
+		drawList.clear();
+		drawList.reserve(BENCHMARK_DRAWS);
+		for (size_t i = 0; i < BENCHMARK_DRAWS; ++i) {
+			drawList.add(draw);
+		}
+
+		JCommandPool primaries(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		auto time = [&](const std::function<void(VkCommandBuffer)>& record) {
+			double seconds = 0.0;
+			for (uint32_t r = 0; r < BENCHMARK_REPEATS; ++r) {
+				primaries.reset();
+				VkCommandBuffer commandBuffer = primaries.acquire();
+				auto start = std::chrono::steady_clock::now();
+				record(commandBuffer);
+				vkCmdEndRenderPass(commandBuffer);
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("failed to record command buffer!");
+				}
+				seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			return seconds / BENCHMARK_REPEATS;
+		};
+
+		std::cout << "recording benchmark: " << BENCHMARK_DRAWS << " draws, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+		double inlineSeconds = time([this](VkCommandBuffer commandBuffer) {
+			beginBenchmarkPass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			recordDraws(commandBuffer, 0, drawList.size(), 0);
+		});
+		std::cout << "  inline, 1 thread: " << inlineSeconds * 1000.0 << " ms" << std::endl;
+
+		uint32_t maxWorkers = std::max(2u, std::thread::hardware_concurrency()) - 1; // it can say 0 if it doesn't know
+		for (uint32_t workers = 1; workers <= maxWorkers; ++workers) {
+			JThreadPool threads(workers);
+			JParallelRecorder parallel(device, &threads, 1, PARALLEL_RECORD_CHUNK);
+			double seconds = time([this, &parallel](VkCommandBuffer commandBuffer) {
+				parallel.reset(0);
+				beginBenchmarkPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				parallel.record(0, commandBuffer, renderPass, 0, swapChainFramebuffers[0], drawList.size(),
+					[this](VkCommandBuffer secondary, size_t begin, size_t end) { recordDraws(secondary, begin, end, 0); });
+			});
+			std::cout << "  parallel, " << threads.slotCount() << " threads: " << seconds * 1000.0 << " ms ("
+				<< inlineSeconds / seconds << "x inline)" << std::endl;
+		}
+	}
+
+	// compile time histograms, and how many draws had to make do without the variant they wanted
+	void printPipelineStats() {
+		JPipelineManagerStats stats = pipelines->stats();
+		std::cout << "pipeline variants: " << stats.variants << " (" << stats.pending << " compiling, " << stats.failed << " failed), "
+			<< stats.fallbackDraws << " draws used a fallback, " << stats.skippedDraws << " skipped" << std::endl;
+		std::cout << "compile times: " << stats.compiles.toString() << " (max " << stats.compiles.maxSeconds * 1000.0 << " ms)" << std::endl;
+		if (stats.hits.count + stats.misses.count > 0) {
+			std::cout << "  cache hits: " << stats.hits.toString() << std::endl;
+			std::cout << "  cache misses: " << stats.misses.toString() << std::endl;
+		}
+	}
+
+	// whether the cache file was used, and what creating pipelines has cost so far
+	void printPipelineCacheStats() {
+		JPipelineCacheStats stats = pipelineCache->stats();
+		if (stats.loaded) {
+			std::cout << "pipeline cache: loaded " << stats.loadedBytes << " bytes from " << pipelineCache->filename() << std::endl;
+		}
+		else if (!stats.rejected.empty()) {
+			std::cout << "pipeline cache: ignored " << pipelineCache->filename() << " (" << stats.rejected << ")" << std::endl;
+		}
+		std::cout << "pipelines: " << stats.pipelines << " created in " << stats.seconds * 1000.0 << " ms, "
+			<< stats.hits << " cache hits (" << stats.hitSeconds * 1000.0 << " ms), "
+			<< stats.misses << " misses (" << stats.missSeconds * 1000.0 << " ms), "
+			<< stats.unknown() << " unknown" << std::endl;
+	}
+
+	// shader modules are compiled and linked when the pipeline is created, so they could be destroyed after
+	// that, but variants can be compiled from them any time
+	// compiled from the glsl on the thread pool (or read back from SHADER_CACHE_DIR), then made into modules
+	// through the shader cache, which hands back the module it already has for SPIR-V it's seen before
+	void createShaderModules() {
+		shaderCompiler = new JShaderCompiler(SHADER_CACHE_DIR, { "shaders" });
+		shaderCache = new JShaderCache(device);
+
+		std::vector<JShaderSource> sources = {
+			{ JShaderType::JVertex, "shaders/shader.vert", {} },
+			{ JShaderType::JFragment, "shaders/shader.frag", {} },
+		};
+		// cache hits go to the driver straight from the mapped cache entry
+		std::vector<const JShaderModule*> modules = shaderCompiler->loadAll(sources, shaderCache, threadPool);
+		vertModule = modules[0];
+		fragModule = modules[1];
+
+		JShaderCompilerStats stats = shaderCompiler->stats();
+		std::cout << "shaders: " << stats.compiled << " compiled, " << stats.cacheHits << " from "
+			<< shaderCompiler->cacheDirectory() << " (" << stats.seconds * 1000.0 << " ms)" << std::endl;
+	}
+
+	// made from what the shaders use (read out of their SPIR-V), through the layout cache, so they always
+	// match the shaders, and pipelines whose shaders agree share them
+	// doesn't depend on the render pass, so it's made once
+	void createLayouts() {
+		layoutCache = new JLayoutCache(device);
+
+		JShaderReflection reflection = vertModule->reflection();
+		reflection.merge(fragModule->reflection());
+		// everything here binds the UBO as set 0, so there has to be one
+		if (reflection.setCount() == 0) {
+			throw std::runtime_error("failed to create layouts, the shaders don't use any descriptor sets (the UBO should be set 0)!");
+		}
+		// the UBO is bound with an offset into the frame allocator, which the SPIR-V can't say
+		reflection.makeDynamic(0, 0);
+
+		JLayout layout = layoutCache->layout(reflection);
+		descriptorSetLayout = layout.setLayouts[0];
+		pipelineLayout = layout.pipelineLayout;
+	}
+
+	// asks the pipeline manager for the variant the render pass and raster state need, it's compiled on
+	// the thread pool, and until it's ready the draws use the last variant (if it's for the same render
+	// pass) or are skipped
 	void createGraphicsPipeline() {
 		//auto vertShaderCode = readFile("shaders/vert.spv");
 		//auto fragShaderCode = readFile("shaders/frag.spv");
 
-		// shader modules are compiled and linked when the pipeline is created, so we can destroy them after that
-		//VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		//VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-		JShaderModule vertModule(device, JShaderType::JVertex, "shaders/vert.spv");
-		JShaderModule fragModule(device, JShaderType::JFragment, "shaders/frag.spv");
-
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo = vertModule.stageInfo();
+		vertShaderStageInfo = vertModule->stageInfo();
 		/*
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT; // vertex shader stage
@@ -833,192 +1116,52 @@ private:
 		// with these values, we're setting it to nullptr
 		*/
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo = fragModule.stageInfo();
+		fragShaderStageInfo = fragModule->stageInfo();
 		/*
 		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT; // vertex shader stage
 		fragShaderStageInfo.module = fragModule.module(); //fragShaderModule;
 		fragShaderStageInfo.pName = "main"; // entry point
 		*/
+		// part of the pipeline's key, changing these asks for (and compiles) another variant
+		JSpecializationConstants fragConstants;
+		fragConstants.set(0, LIGHT_COUNT)
+			.set(1, LIGHTING)
+			.set(2, AMBIENT);
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
+		// create the pipeline
+		// the builder fills in the fixed function state: no blending, no multisampling, and viewport and
+		// scissor dynamic, so the pipeline doesn't depend on the swap chain's size and survives resizes
+		// with extended dynamic state, cull mode, front face, topology and depth are dynamic too
 		auto bindingDescription = Vertex::getBindingDescription();
 		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-		// input assembly describes topology info
-		// point list, line list, line strip, triangle list, triangle strip etc
-		// primitive restart enable allows reseting a strip topology in the middle with indices 0xFFFF or 0xFFFFFFFF
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-		// set up viewport (region of framebuffer to output to)
-		// usually (0,0) to (width,height)
-		// viewport is transformation from image to framebuffer, so changing this would rescale, not clip
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		// scissors clip where we draw
-		// want to draw to the whole framebuffer, so:
-		VkRect2D scissor{};
-		scissor.offset = { 0,0 };
-		scissor.extent = swapChainExtent;
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1; // more than one needs a GPU feature
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		// rasterizer configuration
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE; // discard fragments that are too far away
-		// setting to true requires a GPU feature, and can be useful for things like shadow maps
-		rasterizer.rasterizerDiscardEnable = VK_FALSE; // if true, geometry never passes through rasterizer
-		// no framebuffer output
-		// polygonMode options: FILL, LINE, POINT doing the expected, anything other than fill needs a 
-		// GPU feature
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f; // anything wider than 1.0f requires wideLines GPU feature
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // cull back faces
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; //VK_FRONT_FACE_CLOCKWISE; // front faces are clockwise
-		rasterizer.depthBiasEnable = VK_FALSE; // sometimes used for shadow mapping (bias based on slope)
-		// optional:
-		rasterizer.depthBiasConstantFactor = 0.0f;
-		rasterizer.depthBiasClamp = 0.0f;
-		rasterizer.depthBiasSlopeFactor = 0.0f;
-
-		// multisampling seems very useful, but disable for now
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisampling.minSampleShading = 1.0f; // optional
-		multisampling.pSampleMask = nullptr; // optional
-		multisampling.alphaToCoverageEnable = VK_FALSE; // optional
-		multisampling.alphaToOneEnable = VK_FALSE; // optional
-
-		// no depthstencilstate createinfo struct, we'll just pass a nullptr
-
-		// color blending
-		// two structs, the first is per framebuffer
-		// the second is global color blending settings
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{}; 
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
-			| VK_COLOR_COMPONENT_G_BIT
-			| VK_COLOR_COMPONENT_B_BIT
-			| VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_FALSE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // optional
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // optional
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // optional
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // optional
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // optional
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // optional
-		// the ops do somthing like
-		/*
-		if(blendEnable) {
-			finalColor.rgb = (srcColorBlendFactor * newColor.rgb) <colorBlendOp> 
-				(dstColorBlendFactor * oldColor.rgb);
-			// same for alpha
-		} else {
-			finalColor = newColor;
-		}
-		finalColor = finalColor & colorWriteMask;
-		*/
-
-		// second blending structure
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE; 
-		colorBlending.logicOp = VK_LOGIC_OP_COPY; // optional
-		colorBlending.attachmentCount = 1; // one attachment for one framebuffer
-		colorBlending.pAttachments = &colorBlendAttachment; // the attachement
-		colorBlending.blendConstants[0] = 0.0f; //optional
-		colorBlending.blendConstants[1] = 0.0f; //optional
-		colorBlending.blendConstants[2] = 0.0f; //optional
-		colorBlending.blendConstants[3] = 0.0f; //optional
-		// logic ops being set to true would disable all alpha blending for all framebuffers, colorWriteMask still used
-		// we've disabled both modes so that colors just go through unmodified
-
-		// if you want to allow dynamic state, ten you would have to create a VkDynamicState struct, 
-		// which would cause the values to be ignored.
-		// I'll use a nullptr right now.
-		// things that can be made dynamic: Viewport, line_width, blend_constants
-
-
-		// Pipeline layout (uniform setup)
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1; // one setLayout, for the UBO
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // the UBO layout
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // optional
-
-		if (vkCreatePipelineLayout(device->device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
+		// Vertex has to give the vertex shader every input it reads, in the format it reads it
+		for (const JVertexInput& input : vertModule->reflection().inputs) {
+			auto found = std::find_if(attributeDescriptions.begin(), attributeDescriptions.end(),
+				[&input](const VkVertexInputAttributeDescription& attribute) { return attribute.location == input.location; });
+			if (found == attributeDescriptions.end() || (input.format != VK_FORMAT_UNDEFINED && found->format != input.format)) {
+				throw std::runtime_error("vertex attributes don't match the vertex shader's inputs!");
+			}
 		}
 
-		// create the pipeline
+		JPipelineBuilder builder(device);
+		builder.addStage(vertShaderStageInfo)
+			.addStage(fragShaderStageInfo, fragConstants)
+			.addBinding(bindingDescription)
+			.setRasterState(rasterState) // back face culling, counter clockwise front faces, triangle list
+			.setLayout(pipelineLayout)
+			.setRenderPass(renderPass, 0);
+		for (const auto& attribute : attributeDescriptions) {
+			builder.addAttribute(attribute);
+		}
 
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		// shader stages
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		// struct pointers
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr; // optional
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = nullptr; // optional
-		
-		// layout handle
-		pipelineInfo.layout = pipelineLayout;
-		// render pass
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0; // index of subpass
-
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional
-		// vulkan allows setting up a new pipeline 
-		// by deriving from an existing pipeline, which can be very handy and be more efficient
-		pipelineInfo.basePipelineIndex = -1; // optional
-		// index is an alternative way to specify a parent if you are about to create the parent pipeline
-		// these are only used if VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is set
-		// in the flags field
-
-		// note that you can create multiple piplines in one call
-		// the second arg:
-		// pipeline cache is used to store and reuse data relevant to pipeline creation across multiple  
-		// calls to vkCreateGraphicsPipelines (and even across executions if stored to a file)
-		// later chapter on this in tutorial
-		if (vkCreateGraphicsPipelines(device->device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!"); 
-		}
-
-		// destroy the shader modules 
-		//vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		//vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		// compiled through the pipeline cache, which is saved to a file, so usually quick after the first run
+		uint64_t previousKey = graphicsPipelineKey;
+		graphicsPipelineKey = pipelines->request(builder);
+		graphicsPipelineDynamicRaster = builder.dynamicRaster();
+		// a variant for another render pass isn't compatible with this one
+		fallbackPipelineKey = graphicsPipelineRenderPass == renderPass && previousKey != graphicsPipelineKey ? previousKey : 0;
+		graphicsPipelineRenderPass = renderPass;
 	}
 
 	/*
@@ -1076,40 +1219,35 @@ private:
 			throw std::runtime_error("failed to create command pool!");
 		}
 		*/
-		commandPool = new JCommandPool(device);
-		transientPool = new JCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		// command buffers are rerecorded every frame (the uniform offsets change)
+		// rather than resetting them one at a time, each frame in flight gets its own pool, and the whole
+		// pool is reset with one call once the timeline says the GPU is done with that frame
+		framePools.resize(config.framesInFlight);
+		for (size_t i = 0; i < config.framesInFlight; ++i) {
+			framePools[i] = new JCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		}
+		// one-shot buffers are handed back as soon as they're done, so they need to be individually resettable
+		transientPool = new JCommandPool(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	}
+
+	void createTimeline() {
+		timeline = new JTimeline(device);
+	}
+
+	void createUploadManager() {
+		// the uploads signal the same timeline as the frames, the transient pool is on the graphics queue too
+		uploads = new JUploadManager(device, transientPool, timeline);
 	}
 
 	void createTextureImage() {
-		textureImage = new JImage(device, transientPool, "textures/stones-1000x1000.jpg");
+		textureImage = images.emplace(device, uploads, "textures/stones-1000x1000.jpg");
 	}
 
 	void createVertexBuffer() {
 
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
-		JBuffer stagingBuffer(
-			//physicalDevice,
-			device,
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // used as source to transfer data to another buffer
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // mappable
-		); // automatically destroyed when it goes out of scope
-
-		void* data;
-		// params are device, memory, offset, size, flags, ptr to ptr
-		vkMapMemory(device->device(), stagingBuffer.memory(), 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device->device(), stagingBuffer.memory());
-		// driver may not immediately copy the data on write,
-		// two strategies:
-		// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		// or call
-		// flushmappedmemory ranges after writing to mapped
-		// invalidate mapped memory ranges before reading
-
-
-		vertBuffer = new JBuffer(
+		vertBuffer = buffers.emplace(
 			//physicalDevice,
 			device,
 			bufferSize,
@@ -1117,31 +1255,15 @@ private:
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		copyBuffer(stagingBuffer.buffer(), vertBuffer->buffer(), bufferSize);
-
-		// staging buffer goes out of scope and gets cleaned up
-		// NOTE: IRL should not allocate memory for every buffer, 
-		// should use a custom allocator, or use the VulkanMemoryAllocator library
-		// however, for this tutorial, will be ok.
+		// the upload manager copies vertices into its staging ring and records the copy,
+		// the copy happens when the uploads are submitted
+		uploads->upload(&buffers[vertBuffer], vertices);
+		// buffers don't allocate memory themselves, they sub-allocate from the device's JMemoryAllocator
 	}
 	void createIndexBuffer() {
 		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
-		JBuffer stagingBuffer(
-			//physicalDevice,
-			device,
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // used as source to transfer data to another buffer
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // mappable
-		); // automatically destroyed when it goes out of scope
-
-		void* data;
-		vkMapMemory(device->device(), stagingBuffer.memory(), 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device->device(), stagingBuffer.memory());
-
-
-		indexBuffer = new JBuffer(
+		indexBuffer = buffers.emplace(
 			//physicalDevice,
 			device,
 			bufferSize,
@@ -1149,35 +1271,43 @@ private:
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 		);
 
-		copyBuffer(stagingBuffer.buffer(), indexBuffer->buffer(), bufferSize);
-		// staging buffer goes out of scope and gets cleaned up
+		uploads->upload(&buffers[indexBuffer], indices);
 	}
 
-	void createUniformBuffers() {
-		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-		uniformBuffers.resize(swapChainImages.size());
-		for (auto& uniformBuffer : uniformBuffers) {
-			uniformBuffer = new JBuffer(
-				//physicalDevice,
-				device,
-				bufferSize,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-			);
+	// for unloading at runtime, the buffer/image is only destroyed once the frames that might be
+	// using it are done, the handle goes stale straight away
+	void destroyBuffer(JHandle<JBuffer> handle) {
+		if (buffers.contains(handle)) {
+			deletionQueue.defer(timeline->submitted(), std::move(buffers[handle]));
+			buffers.erase(handle);
+		}
+	}
+	void destroyImage(JHandle<JImage> handle) {
+		if (images.contains(handle)) {
+			deletionQueue.defer(timeline->submitted(), std::move(images[handle]));
+			images.erase(handle);
 		}
 	}
 
+	void createFrameAllocator() {
+		// one region per frame in flight, not per swap chain image, so it survives swap chain recreation
+		frameAllocator = new JFrameAllocator(device, FRAME_ALLOCATOR_SIZE, config.framesInFlight);
+	}
+
+	void createRecorder() {
+		recorder = new JParallelRecorder(device, threadPool, config.framesInFlight, PARALLEL_RECORD_CHUNK);
+	}
+
 	void createDescriptorPool() {
 		VkDescriptorPoolSize poolSize{};
-		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		poolSize.descriptorCount = 1;
 		
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		poolInfo.poolSizeCount = 1;
 		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size()); // maximum number of descriptor sets
+		poolInfo.maxSets = 1; // maximum number of descriptor sets
 
 		if (vkCreateDescriptorPool(device->device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor pool!");
@@ -1185,170 +1315,86 @@ private:
 	}
 
 	void createDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
 		VkDescriptorSetAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-		allocInfo.pSetLayouts = layouts.data(); 
-		// we need an array of layouts
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout; 
 
-		descriptorSets.resize(swapChainImages.size());
-		if (vkAllocateDescriptorSets(device->device(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		if (vkAllocateDescriptorSets(device->device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate descriptor sets!");
 		}
 
 		// don't need to clean up descriptor sets b/c they are automatically freed when 
 		// the descriptor pool is destroyed
-		// we've allocated all of the descriptor sets, but we need to configure each of them
-		for (size_t i = 0; i < swapChainImages.size(); ++i) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = uniformBuffers[i]->buffer();
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject); // could use WHOLE_SIZE here
-
-			VkWriteDescriptorSet descriptorWrite{};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i]; // the descriptor set we want to write
-			descriptorWrite.dstBinding = 0; // binding index 0
-			descriptorWrite.dstArrayElement = 0; // index in the array we want to update, just 0, since not using an array
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrite.descriptorCount = 1; // can update multiple descriptors at once, just update one
-			// use one of these three, note the last two are optional
-			descriptorWrite.pBufferInfo = &bufferInfo; 
-			descriptorWrite.pImageInfo = nullptr; // descriptors referring to image data
-			descriptorWrite.pTexelBufferView = nullptr; // used for descriptors that refer to buffer views
-			vkUpdateDescriptorSets(device->device(), 1, &descriptorWrite, 0, nullptr); // the last two args are for copying  descriptors
-		}
-	}
-
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		//<std::is_function<void(JCommandBuffer)>, void >
-		JCommandBuffers::runWithSingleTimeCommandBuffer(
-			transientPool,
-			[srcBuffer, dstBuffer, size](JCommandBuffer buffer)->int {
-					VkBufferCopy copyRegion{};
-					copyRegion.size = size;
-					vkCmdCopyBuffer(buffer.buffer(), srcBuffer, dstBuffer, 1, &copyRegion);
-				});
-		
-		/*
-		// need to allocate a temporary command buffer
-		// might want a separate command pool for temporary command buffers so that 
-		// we can pass the VK_COMMAND_POOL_CREATE_TRANSIENT_BIT flag
-		// the implementation might be able to optimize in that case
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // primary command buffer
-		allocInfo.commandPool = transientPool->pool(); // main command pool
-		allocInfo.commandBufferCount = 1; // one command buffer
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device->device(), &allocInfo, &commandBuffer);
-		
-		// record it
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // only going to use this once
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0; // optional
-		copyRegion.dstOffset = 0; // optional
-		copyRegion.size = size;
-
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion); // takes an array of regions
-		// note not allowed to specify VK_WHOLE_SIZE for copyRegion.size
-		vkEndCommandBuffer(commandBuffer); // just want to copy, so stop recording
-
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(device->graphicsQueue()); // could also use a fence and wait on the fence
-
-		vkFreeCommandBuffers(device->device(), transientPool->pool(), 1, &commandBuffer);
-		*/
+		// the set points at one UBO sized window of the frame allocator's buffer, the dynamic offset
+		// slides it to whichever object is being drawn
+		VkDescriptorBufferInfo bufferInfo = frameAllocator->descriptorInfo(sizeof(UniformBufferObject));
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet; // the descriptor set we want to write
+		descriptorWrite.dstBinding = 0; // binding index 0
+		descriptorWrite.dstArrayElement = 0; // index in the array we want to update, just 0, since not using an array
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite.descriptorCount = 1; // can update multiple descriptors at once, just update one
+		// use one of these three, note the last two are optional
+		descriptorWrite.pBufferInfo = &bufferInfo; 
+		descriptorWrite.pImageInfo = nullptr; // descriptors referring to image data
+		descriptorWrite.pTexelBufferView = nullptr; // used for descriptors that refer to buffer views
+		vkUpdateDescriptorSets(device->device(), 1, &descriptorWrite, 0, nullptr); // the last two args are for copying  descriptors
 	}
 
+	// this frame's draws, there's only the one object for now
+	// rebuilt every frame, the draw list notices if it comes out the same
+	// everything goes through the draw queue, which sorts by pass, then state, then depth
+	void buildDrawList() {
+		drawQueue.clear();
+
+		JDraw draw;
+		draw.vertexBuffer = buffers[vertBuffer].buffer();
+		draw.indexBuffer = buffers[indexBuffer].buffer();
+		draw.indexType = VK_INDEX_TYPE_UINT16;
+		draw.indexCount = static_cast<uint32_t>(indices.size());
+		draw.uniformOffset = 0; // the frame's only uniforms
+		// opaque, one pipeline, one material, one mesh
+		float depth = glm::length(cameraPosition) / farPlane; // the model sits at the origin
+		drawQueue.push(JSortKey::opaque(0, 0, 0, 0, depth), draw);
+
+		drawList.clear();
+		drawQueue.copyTo(drawList, threadPool);
+	}
 
-	void createCommandBuffers() {
-		/*
-		commandBuffers.resize(swapChainFramebuffers.size());
-		
-		// need allocateInfo
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = commandPool->pool();
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // primary or secondary
-		// primary can be submitted to a queue for execution, but not called from other buffers
-		// secondary can be called from other buffers, but not submitted directly
-		allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-		if (vkAllocateCommandBuffers(device->device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate command buffers!");
+	// records drawList's draws [begin, end) into commandBuffer, uniformBase is where this frame's uniforms start
+	// runs on worker threads when recording in parallel, so it only reads
+	void recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end, uint32_t uniformBase) {
+		// skips binding anything that's already bound, so consecutive draws sharing state only cost the draw
+		JCommandRecorder recorder(commandBuffer);
+
+		// bind the pipeline
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		// secondaries don't inherit dynamic state, so every buffer sets its own
+		JPipelineBuilder::setViewportAndScissor(commandBuffer, swapChainExtent);
+		if (graphicsPipelineDynamicRaster) {
+			JPipelineBuilder::applyRasterState(device, commandBuffer, rasterState);
 		}
-		*/
-		commandBuffers = new JCommandBuffers(commandPool, swapChainFramebuffers.size(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-
-		for (size_t i = 0; i < commandBuffers->size(); ++i) {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0; // optional
-			// flags: ONE_TIME_SUBMIT (rerecorded after executing once)
-			// RENDER_PASS_CONTINUE (secondary command buffer entirely w/in a single render pass)
-			// SIMULTANEOUS_USE (can be resubmitted while it is already pending execution)
-			beginInfo.pInheritanceInfo = nullptr; // optional
-			// only for secondary command buffers, what state to inherit from primary command buffers
-
-			// beginCommandBuffer will reset the command buffer (implicitly)
-			//if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			if ((*commandBuffers)[i].beginCommandBuffer(&beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
-			}
 
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			// framebuffer to render into
-
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = swapChainExtent; // render to full area of image. 
-			// pixels outside this area have undefined values
-
-			VkClearValue  clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor; // not sure why this is an array, perhaps if we had
-			// several layers or something?
-			// clear color to use for LOAD_OP_CLEAR 
-
-			vkCmdBeginRenderPass((*commandBuffers)[i].buffer(), &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-			// start the render pass, vkCmd prefix identifies functions that record commands
-			// SUBPASS_CONTENTS: INLINE (render pass commands are in primary command buffer, no secondary command buffers)
-			// SECONDARY_COMMAND_BUFFERS (render pass commands will be executed from secondary command buffers)
-			
-			// bind the pipeline
-			vkCmdBindPipeline((*commandBuffers)[i].buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-			
-			VkBuffer vertexBuffers[] = { vertBuffer->buffer() };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers((*commandBuffers)[i].buffer(), 0, 1, vertexBuffers, offsets);
+		for (size_t d = begin; d < end; ++d) {
+			const JDraw& draw = drawList[d];
 
-			vkCmdBindIndexBuffer((*commandBuffers)[i].buffer(), indexBuffer->buffer(), 0, VK_INDEX_TYPE_UINT16);
+			recorder.bindVertexBuffer(0, draw.vertexBuffer);
+			recorder.bindIndexBuffer(draw.indexBuffer, 0, draw.indexType);
 
 			// bind descriptor sets 
-			vkCmdBindDescriptorSets(
-				(*commandBuffers)[i].buffer(), 
+			uint32_t uniformOffset = uniformBase + draw.uniformOffset;
+			recorder.bindDescriptorSets(
 				VK_PIPELINE_BIND_POINT_GRAPHICS, // bind to graphics pipeline
 				pipelineLayout, // layout descriptors are based on
 				0, // index of first descriptor sets
 				1, // number of sets to bind 
-				&descriptorSets[i], // array of descriptor sets
-				0, // array of offsets for dynamic descriptors (used in a future chapter)
-				nullptr);
+				&descriptorSet, // array of descriptor sets
+				1, // array of offsets for dynamic descriptors, one per dynamic descriptor in the sets
+				&uniformOffset);
 
 			// draw has parameters
 			// vertexCount (3 vertices)
@@ -1356,36 +1402,129 @@ private:
 			// firstVertex (offset into vertex buffer, defines lowest value of gl_VertexIndex)
 			// firstInstance (used as an offset for instanced rendering, lowest value of gl_InstanceIndex)
 			//vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-			vkCmdDrawIndexed((*commandBuffers)[i].buffer(), static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-			// 1 instance, the zeros are offset into index, offset to add to indices in index buffer, then
-			// offset for instancing, which we're not using
-			vkCmdEndRenderPass((*commandBuffers)[i].buffer());
-			if ((*commandBuffers)[i].endCommandBuffer() != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
-			}
+			recorder.drawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, 0);
+		}
+
+		// this might be on a worker thread
+		std::lock_guard<std::mutex> lock(recordStatsMutex);
+		recordStats += recorder.stats();
+	}
+
+	// records drawList into commandBuffer, for swap chain image i
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t i, uint32_t uniformBase) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = 0; // resubmitted as long as nothing it was recorded from changes
+		// flags: ONE_TIME_SUBMIT (rerecorded after executing once)
+		// RENDER_PASS_CONTINUE (secondary command buffer entirely w/in a single render pass)
+		// SIMULTANEOUS_USE (can be resubmitted while it is already pending execution)
+		beginInfo.pInheritanceInfo = nullptr; // optional
+		// only for secondary command buffers, what state to inherit from primary command buffers
+
+		// the frame's pool was reset before this buffer was acquired, so it's ready to record
+		//if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
 		}
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = swapChainFramebuffers[i];
+		// framebuffer to render into
+
+		renderPassInfo.renderArea.offset = { 0,0 };
+		renderPassInfo.renderArea.extent = swapChainExtent; // render to full area of image. 
+		// pixels outside this area have undefined values
+
+		VkClearValue  clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor; // not sure why this is an array, perhaps if we had
+		// several layers or something?
+		// clear color to use for LOAD_OP_CLEAR 
+
+		// big draw lists are split up and recorded into secondary buffers on the thread pool
+		// without a pipeline (it's still compiling) the pass only clears
+		bool drawing = graphicsPipeline != VK_NULL_HANDLE;
+		bool parallel = drawing && recorder->worthRecordingInParallel(drawList.size());
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, 
+			parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		// start the render pass, vkCmd prefix identifies functions that record commands
+		// SUBPASS_CONTENTS: INLINE (render pass commands are in primary command buffer, no secondary command buffers)
+		// SECONDARY_COMMAND_BUFFERS (render pass commands will be executed from secondary command buffers)
+
+		if (parallel) {
+			recorder->record(static_cast<uint32_t>(currentFrame), commandBuffer, renderPass, 0, swapChainFramebuffers[i], drawList.size(),
+				[this, uniformBase](VkCommandBuffer secondary, size_t begin, size_t end) { recordDraws(secondary, begin, end, uniformBase); });
+		}
+		else if (drawing) {
+			recordDraws(commandBuffer, 0, drawList.size(), uniformBase);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+
+	// the command buffer to submit for swap chain image imageIndex this frame
+	// the timeline has passed the current frame's last submission, so none of its buffers are in use, if anything they were
+	// recorded from has changed they're all thrown away (by resetting the pools), otherwise the one for
+	// this image is reused, and only recorded if this frame hasn't drawn to the image yet
+	VkCommandBuffer frameCommandBuffer(uint32_t imageIndex, uint32_t uniformBase) {
+		FrameRecording& recording = frameRecordings[currentFrame];
+		uint64_t drawListVersion = drawList.version();
+
+		if (!recording.valid
+			|| recording.drawListVersion != drawListVersion
+			|| recording.swapChainGeneration != swapChainGeneration
+			|| recording.pipeline != graphicsPipeline
+			|| recording.rasterState != rasterState
+			|| recording.uniformBase != uniformBase) {
+			framePools[currentFrame]->reset();
+			recorder->reset(static_cast<uint32_t>(currentFrame));
+
+			recording.valid = true;
+			recording.drawListVersion = drawListVersion;
+			recording.swapChainGeneration = swapChainGeneration;
+			recording.pipeline = graphicsPipeline;
+			recording.rasterState = rasterState;
+			recording.uniformBase = uniformBase;
+			recording.imageBuffers.assign(swapChainImages.size(), VK_NULL_HANDLE);
+		}
+
+		VkCommandBuffer& commandBuffer = recording.imageBuffers[imageIndex];
+		if (commandBuffer != VK_NULL_HANDLE) {
+			++framesReused;
+			return commandBuffer;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		// comes off the free list the pool was reset into, only allocated the first time round
+		commandBuffer = framePools[currentFrame]->acquire();
+		recordCommandBuffer(commandBuffer, imageIndex, uniformBase);
+		recordSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		++framesRecorded;
+		return commandBuffer;
 	}
 
 	void createSyncObjects() {
-		// semaphores for GPU-GPU sync
-		// fences for CPU-GPU sync
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT); 
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE); // initialize to no fence to start with
+		// binary semaphores for GPU-GPU sync with the swap chain
+		// the timeline (created with the upload manager) for CPU-GPU sync
+		imageAvailableSemaphores.resize(config.framesInFlight);
+		renderFinishedSemaphores.resize(config.framesInFlight);
+		frameValues.resize(config.framesInFlight, 0); // 0 is already reached, so the first frames don't wait
+		frameRecordings.resize(config.framesInFlight);
+		imageValues.assign(swapChainImages.size(), 0);
 
 		VkSemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 		// no other required fields right now
 
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // create fences signaled for first frames
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		for (size_t i = 0; i < config.framesInFlight; ++i) {
 			if (vkCreateSemaphore(device->device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS
 				|| vkCreateSemaphore(device->device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS
-				|| vkCreateFence(device->device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS
 				) {
 				throw std::runtime_error("failed to create semaphores for a frame!");
 			}
@@ -1393,19 +1532,104 @@ private:
 	}
 
 	void mainLoop() {
+		auto startTime = std::chrono::steady_clock::now();
+		auto lastStatsTime = startTime;
+		dumpMemoryStats(0.0);
+
 		// check for events until the window should close
 		while (!glfwWindowShouldClose(window)) {
+			// low latency: don't sample input until the GPU has caught up, so it isn't sitting behind
+			// queued frames, otherwise drawFrame only waits for a frame slot, after the input's been sampled
+			if (config.lowLatency) {
+				timeline->wait(lastFrameValue);
+			}
 			glfwPollEvents();
+			inputTime = std::chrono::steady_clock::now();
 			drawFrame();
+
+			auto now = std::chrono::steady_clock::now();
+			if (std::chrono::duration<double>(now - lastStatsTime).count() >= MEMORY_STATS_INTERVAL) {
+				lastStatsTime = now;
+				double time = std::chrono::duration<double>(now - startTime).count();
+				dumpMemoryStats(time);
+				dumpLatencyStats(time);
+				printRecordStats();
+			}
 		}
 
 		vkDeviceWaitIdle(device->device());
 	}
 
+	void dumpMemoryStats(double time) {
+		JMemoryStats stats = device->allocator()->stats();
+		std::ofstream file(MEMORY_STATS_FILE, std::ios::app);
+		file << stats.toJson(time) << std::endl;
+		if (stats.overBudget()) {
+			std::cerr << "device memory usage is over budget!" << std::endl;
+		}
+	}
+
+	// gpu completion latency of the frames the timeline shows are done, see pendingGpuLatency
+	void collectGpuLatency() {
+		uint64_t completed = timeline->completed();
+		auto now = std::chrono::steady_clock::now();
+		while (!pendingGpuLatency.empty() && pendingGpuLatency.front().first <= completed) {
+			gpuLatency.record(std::chrono::duration<double>(now - pendingGpuLatency.front().second).count());
+			pendingGpuLatency.pop_front();
+		}
+	}
+
+	// appends the latency since the last call, with the settings it was measured under, so runs with
+	// different settings can be compared
+	void dumpLatencyStats(double time) {
+		if (presentLatency.count() == 0) {
+			return;
+		}
+		const char* presentMode = JConfig::presentModeName(swapChainPresentMode);
+		std::ofstream file(config.latencyStatsFile, std::ios::app);
+		file << "{\"time\":" << time << ",\"settings\":" << config.toJson() << ",\"presentMode\":\"" << presentMode << "\""
+			<< ",\"present\":" << presentLatency.toJson() << ",\"gpuComplete\":" << gpuLatency.toJson() << "}" << std::endl;
+		std::cout << "latency: input to present " << presentLatency.average() * 1000.0 << " ms average, "
+			<< presentLatency.percentile(0.99) * 1000.0 << " ms p99, input to gpu completion " << gpuLatency.average() * 1000.0
+			<< " ms average, " << gpuLatency.percentile(0.99) * 1000.0 << " ms p99 (" << presentMode << ", "
+			<< config.framesInFlight << " frames in flight" << (config.lowLatency ? ", low latency" : "") << ")" << std::endl;
+		presentLatency.reset();
+		gpuLatency.reset();
+	}
+
+	// how many frames were recorded rather than reused since the last call, what recording cost, and how
+	// many binds the recorders skipped
+	void printRecordStats() {
+		if (framesRecorded + framesReused == 0) {
+			return;
+		}
+		double averageMs = framesRecorded > 0 ? recordSeconds * 1000.0 / framesRecorded : 0.0;
+		std::cout << "command buffers: " << framesRecorded << " recorded (" << averageMs << " ms each), "
+			<< framesReused << " reused, " << drawList.size() << " draws" << std::endl;
+		std::cout << "binds: " << recordStats.issued() << " issued, " << recordStats.elided() << " elided (pipeline "
+			<< recordStats.pipelineBindsElided << ", vertex " << recordStats.vertexBufferBindsElided << ", index "
+			<< recordStats.indexBufferBindsElided << ", descriptor " << recordStats.descriptorSetBindsElided << ", push constant "
+			<< recordStats.pushConstantsElided << ")" << std::endl;
+		framesRecorded = 0;
+		framesReused = 0;
+		recordSeconds = 0.0;
+		recordStats = JRecordStats{};
+	}
+
 	void drawFrame() {
-		// wait for fence for current frame
-		// waits on an array of fences, true means wait for all of them
-		vkWaitForFences(device->device(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		// wait until the GPU is done with the last frame that used this frame's resources
+		// nothing to reset afterwards, unlike a fence
+		timeline->wait(frameValues[currentFrame]);
+
+		// the wait might have got further than this frame, so ask what's actually done
+		deletionQueue.retire(timeline->completed());
+		collectGpuLatency();
+
+		// the GPU is done with everything this frame allocated last time around
+		frameAllocator->beginFrame(currentFrame);
+
+		// hand staging memory from finished uploads back to the upload manager
+		uploads->collect();
 		
 		uint32_t imageIndex;
 		// params: 
@@ -1426,13 +1650,17 @@ private:
 		}
 
 		// wait until this image is free, (i.e., not being used by a previous frame)
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device->device(), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-		}
-		// mark image as being in use by a frame
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-
-		updateUniformBuffer(imageIndex);
+		// 0 (never rendered to) is always reached
+		timeline->wait(imageValues[imageIndex]);
+
+		// the uniforms are rewritten every frame, but land at the same offset, so they don't
+		// stop the last recording from being reused
+		uint32_t uniformBase = updateUniformBuffer();
+		buildDrawList();
+		// the variant might still be compiling, then this is the fallback or VK_NULL_HANDLE (nothing's drawn)
+		graphicsPipeline = pipelines->resolve(graphicsPipelineKey, fallbackPipelineKey, drawList.size());
+		VkCommandBuffer commandBuffer = frameCommandBuffer(imageIndex, uniformBase);
+		frameAllocator->flush(); // everything written into this frame's memory
 
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1446,19 +1674,30 @@ private:
 		// wait stages <-> wait semaphores
 		
 		submitInfo.commandBufferCount = 1;
-		VkCommandBuffer buffer = (*commandBuffers)[imageIndex].buffer();
-		submitInfo.pCommandBuffers = &buffer;
+		submitInfo.pCommandBuffers = &commandBuffer;
 
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
+		// the frame signals the next timeline value as well as the binary semaphore present waits on
+		uint64_t frameValue = timeline->advance();
+		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], timeline->semaphore() };
+		uint64_t signalValues[] = { 0, frameValue }; // the binary semaphore's value is ignored
+		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = signalSemaphores; // which semaphores to signal once 
 		// command buffers have finished execution
 
-		vkResetFences(device->device(), 1, &inFlightFences[currentFrame]); // reset the fence for this frame
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 2;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+		submitInfo.pNext = &timelineInfo;
+
+		frameValues[currentFrame] = frameValue;
+		imageValues[imageIndex] = frameValue;
+		lastFrameValue = frameValue;
+		pendingGpuLatency.emplace_back(frameValue, inputTime);
 
 		// Queue submit takes an array of submit info structures 
-		// last parameter is an optional fence signaled when the command buffers finish execution
-		if (vkQueueSubmit(device->graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+		// last parameter is an optional fence signaled when the command buffers finish execution, the timeline does that job
+		if (vkQueueSubmit(device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
 			throw std::runtime_error("failed to submit draw command buffer!");
 		}
 
@@ -1468,7 +1707,7 @@ private:
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores; // render finished semaphore
+		presentInfo.pWaitSemaphores = signalSemaphores; // render finished semaphore (the first one)
 		// the semaphore to wait on
 		VkSwapchainKHR swapChains[] = { swapChain };
 		presentInfo.swapchainCount = 1;
@@ -1482,6 +1721,9 @@ private:
 		// of:
 		result = vkQueuePresentKHR(device->presentQueue(), &presentInfo);
 		// error handling to come later
+		if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+			presentLatency.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - inputTime).count());
+		}
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
 			framebufferResized = false; // need to resize after vkQueuePresentKHR to ensure
@@ -1493,47 +1735,38 @@ private:
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		currentFrame = (currentFrame + 1) % config.framesInFlight;
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
-		static auto startTime = std::chrono::high_resolution_clock::now();
+	// returns the dynamic offset of this frame's uniforms
+	uint32_t updateUniformBuffer() {
+		static auto startTime = inputTime;
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		// animate to when input was sampled, not now, so the frame shows the state latency is measured from
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(inputTime - startTime).count();
 		// time in seconds since rendering has started as a float
 
 		UniformBufferObject ubo{};
 		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		// existing transform, 90 degrees/second, rotation vector (positive z axis)
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.view = glm::lookAt(cameraPosition, cameraTarget, glm::vec3(0.0f, 0.0f, 1.0f));
 		// look from 2,2,2 to origin with positive z axis defining the up direction
 		ubo.proj = glm::perspective(
 			glm::radians(45.0f), // vertical fov
 			swapChainExtent.width / (float)swapChainExtent.height, // aspect ratio
-			0.1f, // near plane
-			10.0f); // far plane
+			nearPlane, // near plane
+			farPlane); // far plane
 		ubo.proj[1][1] *= -1; // Y axis is inverted in GLM b/c it's inverted in OpenGL
 		
-		void* data;
-		vkMapMemory(device->device(), uniformBuffers[currentImage]->memory(), 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(device->device(), uniformBuffers[currentImage]->memory());
+		// the frame allocator stays mapped, so this is just a bump and a memcpy
+		JFrameAllocation allocation = frameAllocator->pushUniform(ubo);
+		return static_cast<uint32_t>(allocation.offset);
 	}
 
 	// note that command pools only depend on the logical device, not the swap chain.
-	void createSwapChainAndFollowing() {
-		createSwapChain();
-		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
-	}
-
+	// doesn't wait for the device: the new swap chain is made from the old one, and everything that
+	// depended on the old one goes through the deletion queue, so frames still in flight finish with it
+	// the render pass, pipeline, descriptors and uniforms don't depend on the size and are kept
 	void recreateSwapChain() {
 		int width = 0, height = 0;
 		glfwGetFramebufferSize(window, &width, &height);
@@ -1543,60 +1776,119 @@ private:
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(device->device());
+		VkFormat oldFormat = swapChainImageFormat;
+		VkSwapchainKHR oldSwapChain = swapChain;
+		cleanupSwapChainViews();
+		createSwapChain(oldSwapChain);
+		retireSwapChain(oldSwapChain);
+		createImageViews();
+		if (swapChainImageFormat != oldFormat) {
+			// the render pass (and so the pipeline) only depend on the format, which hardly ever changes
+			cleanupRenderPass();
+			createRenderPass();
+			createGraphicsPipeline();
+		}
+		createFramebuffers();
+		++swapChainGeneration; // every frame's recordings point at the old framebuffers
+		imageValues.assign(swapChainImages.size(), 0); // the new images haven't been rendered to
 
-		cleanupSwapChain();
-		createSwapChainAndFollowing();
+		deletionQueue.retire(timeline->completed());
 	}
 
-	void cleanupSwapChain() {
+	// hands the framebuffers and image views to the deletion queue, they're destroyed once the frames
+	// that were using them are done
+	void cleanupSwapChainViews() {
+		VkDevice vkDevice = device->device();
+		uint64_t lastUse = timeline->submitted();
 
 		for (auto framebuffer : swapChainFramebuffers) {
-			vkDestroyFramebuffer(device->device(), framebuffer, nullptr);
+			deletionQueue.enqueue(lastUse, [vkDevice, framebuffer]() { vkDestroyFramebuffer(vkDevice, framebuffer, nullptr); });
 		}
+		swapChainFramebuffers.clear();
 
-		// frees command buffers without recreating the command pool
-		//vkFreeCommandBuffers(device->device(), commandPool->pool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-		delete commandBuffers; commandBuffers = nullptr;
-
-		vkDestroyPipeline(device->device(), graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(device->device(), pipelineLayout, nullptr);
-		vkDestroyRenderPass(device->device(), renderPass, nullptr);
+		// command buffers don't depend on the swap chain any more, they come from the frame pools
 
 		for (auto imageView : swapChainImageViews) {
-			vkDestroyImageView(device->device(), imageView, nullptr);
+			deletionQueue.enqueue(lastUse, [vkDevice, imageView]() { vkDestroyImageView(vkDevice, imageView, nullptr); });
 		}
+		swapChainImageViews.clear();
+	}
 
-		vkDestroySwapchainKHR(device->device(), swapChain, nullptr);
-
-		for (auto& uniformBuffer : uniformBuffers) {
-			delete uniformBuffer;
-			uniformBuffer = nullptr;
+	// the swap chain's images go with it, after the last frame that drew to them
+	// (nothing in core Vulkan says when the presentation engine is done with them, but it's done
+	// presenting an image before a later frame's work finishes, which is as close as it gets)
+	void retireSwapChain(VkSwapchainKHR oldSwapChain) {
+		if (oldSwapChain == VK_NULL_HANDLE) {
+			return;
 		}
+		VkDevice vkDevice = device->device();
+		deletionQueue.enqueue(timeline->submitted(), [vkDevice, oldSwapChain]() { vkDestroySwapchainKHR(vkDevice, oldSwapChain, nullptr); });
+	}
 
-		vkDestroyDescriptorPool(device->device(), descriptorPool, nullptr);
+	// the pipelines made with it go too, the pipeline manager waits for any still compiling against it first
+	// (the driver can hand the same handle to the next render pass, which mustn't get these)
+	void cleanupRenderPass() {
+		VkDevice vkDevice = device->device();
+		VkRenderPass pass = renderPass;
+		std::vector<VkPipeline> passPipelines = pipelines->release(pass);
+		deletionQueue.enqueue(timeline->submitted(), [vkDevice, pass, passPipelines]() {
+			for (VkPipeline pipeline : passPipelines) {
+				vkDestroyPipeline(vkDevice, pipeline, nullptr);
+			}
+			vkDestroyRenderPass(vkDevice, pass, nullptr);
+		});
+		graphicsPipelineKey = 0;
+		fallbackPipelineKey = 0;
+		graphicsPipelineRenderPass = VK_NULL_HANDLE;
 	}
 
 	void cleanup() {
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		for (size_t i = 0; i < config.framesInFlight; ++i) {
 			vkDestroySemaphore(device->device(), renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(device->device(), imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device->device(), inFlightFences[i], nullptr);
 		}
 
-		cleanupSwapChain();
+		printPipelineStats();
+		pipelines->waitIdle(); // nothing can still be compiling against the render pass when it goes
 
-		delete textureImage;
+		cleanupSwapChainViews();
+		cleanupRenderPass();
+		retireSwapChain(swapChain);
+		swapChain = VK_NULL_HANDLE;
+		deletionQueue.flush(); // the device is idle (mainLoop waited), so everything can go
 
-		vkDestroyDescriptorSetLayout(device->device(), descriptorSetLayout, nullptr);
+		images.clear();
+
+		vkDestroyDescriptorPool(device->device(), descriptorPool, nullptr);
+		delete frameAllocator; frameAllocator = nullptr;
+		delete recorder; recorder = nullptr;
+
+		delete pipelines; pipelines = nullptr; // before the thread pool
+		delete threadPool; threadPool = nullptr;
+		vertModule = nullptr;
+		fragModule = nullptr;
+		delete shaderCache; shaderCache = nullptr;
+		delete shaderCompiler; shaderCompiler = nullptr;
+		delete layoutCache; layoutCache = nullptr; // the pipeline and descriptor set layouts
+
+		printPipelineCacheStats();
+		if (!pipelineCache->save()) {
+			std::cerr << "failed to save pipeline cache to " << pipelineCache->filename() << std::endl;
+		}
+		delete pipelineCache; pipelineCache = nullptr;
 
-		delete vertBuffer; vertBuffer = nullptr;
-		delete indexBuffer; indexBuffer = nullptr;
+		buffers.clear();
 		//vkDestroyBuffer(device, vertexBuffer, nullptr);
 		//vkFreeMemory(device, vertexBufferMemory, nullptr); // can be freed when the buffer is not longer in use
 
+		delete uploads; uploads = nullptr; // needs the transient pool to free its command buffers
+		delete timeline; timeline = nullptr;
+
 		//vkDestroyCommandPool(device->device(), commandPool, nullptr);
-		delete commandPool; commandPool = nullptr;
+		for (JCommandPool* pool : framePools) {
+			delete pool;
+		}
+		framePools.clear();
 		delete transientPool; transientPool = nullptr;
 
 		//vkDestroyDevice(device, nullptr); // destroy the logical device
@@ -1637,11 +1929,20 @@ private:
 };
 
 
-int main() {
+int main(int argc, char** argv) {
 	HelloTriangleApplication app;
 
 	try {
-		app.run();
+		JConfig config;
+		if (std::ifstream(CONFIG_FILE).good()) {
+			config.load(CONFIG_FILE);
+		}
+		config.parseArgs(argc, argv); // overrides the file
+		if (config.mode == JRunMode::JTestMemoryTypes) {
+			JMemoryTypeTests tests(std::cout);
+			return tests.run() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		app.run(config);
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
@@ -7,13 +7,26 @@ layout(location = 2) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
-vec3 lightPos = vec3(-2.0,2.0,2.0);
+// specialization constants, set per pipeline (see JSpecializationConstants), so the branches and the
+// loop are decided when the pipeline is compiled, these are only the defaults
+layout(constant_id = 0) const int LIGHT_COUNT = 1; // up to MAX_LIGHTS, any more are ignored
+layout(constant_id = 1) const bool LIGHTING = true; // false is flat, just the vertex colours
+layout(constant_id = 2) const float AMBIENT = 0.1; // the darkest a lit surface gets
+
+const int MAX_LIGHTS = 4;
+const vec3 lightPos[MAX_LIGHTS] = vec3[](vec3(-2.0,2.0,2.0), vec3(2.0,2.0,2.0), vec3(0.0,-2.0,2.0), vec3(0.0,0.0,-3.0));
 
 void main() {
-	vec3 lightDir = normalize(lightPos-fragPos);
-	vec3 normal = normalize(fragNormal);
-	float ratio = dot(lightDir, normal); // light ratio
-	ratio = clamp(ratio, 0.1, 1.0);
+	float ratio = 1.0; // light ratio
+	if (LIGHTING) {
+		vec3 normal = normalize(fragNormal);
+		ratio = 0.0;
+		for (int i = 0; i < min(LIGHT_COUNT, MAX_LIGHTS); ++i) {
+			vec3 lightDir = normalize(lightPos[i]-fragPos);
+			ratio += max(dot(lightDir, normal), 0.0);
+		}
+		ratio = clamp(ratio, AMBIENT, 1.0);
+	}
 	//float ratio = 1.0;
 	//outColor = vec4((0.5*normal) + vec3(0.5,0.5,0.5), 1.0);
 	outColor = vec4(ratio*fragColor, 1.0);
@@ -19,4 +19,13 @@ std::vector<char> readFile(const std::string& filename) {
 	file.close(); // close file
 
 	return buffer;
-}
\ No newline at end of file
+}
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull; // FNV prime
+	}
+	return hash;
+}
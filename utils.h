@@ -2,7 +2,13 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 std::vector<char> readFile(const std::string& filename);
 
+// 64 bit FNV-1a, pass the last result as hash to carry on over several pieces
+// fast and good enough for cache keys and spotting corrupt files, not for anything adversarial
+const constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS);
+
 inline const constexpr double PI=3.141592;
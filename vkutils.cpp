@@ -3,19 +3,146 @@
 
 
 
-uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+// bits that are never wanted unless explicitly asked for
+static const VkMemoryPropertyFlags EXOTIC_MEMORY_FLAGS = VK_MEMORY_PROPERTY_PROTECTED_BIT
+	| VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD
+	| VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD;
 
+static inline int countBits(VkMemoryPropertyFlags flags) {
+	int count = 0;
+	for (; flags; flags &= flags - 1) {
+		++count;
+	}
+	return count;
+}
+
+bool isUnifiedMemory(const VkPhysicalDeviceMemoryProperties& memProperties) {
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; ++i) {
+		if (!(memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+			return false;
+		}
+	}
+	return memProperties.memoryHeapCount > 0;
+}
+
+// is there a big DEVICE_LOCAL | HOST_VISIBLE heap, i.e. resizable BAR
+static bool hasLargeBar(const VkPhysicalDeviceMemoryProperties& memProperties) {
+	const VkMemoryPropertyFlags bar = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
-		if ((typeFilter & (1 << i)) // check if the ith bit in type filter is 1
-			&& (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			// check to make sure it has all of the properties
-			return i;
+		const VkMemoryType& type = memProperties.memoryTypes[i];
+		if ((type.propertyFlags & bar) == bar && memProperties.memoryHeaps[type.heapIndex].size > SMALL_BAR_HEAP_SIZE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<MemoryTypeRequest> memoryTypePolicy(const VkPhysicalDeviceMemoryProperties& memProperties,
+	MemoryUsage usage, VkMemoryPropertyFlags properties) {
+	const VkMemoryPropertyFlags hostMask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	bool unified = isUnifiedMemory(memProperties);
+	bool largeBar = hasLargeBar(memProperties);
+
+	std::vector<MemoryTypeRequest> requests;
+	switch (usage) {
+	case MemoryUsage::GpuOnly:
+		// stay out of the host visible types unless that's all there is (UMA), so the BAR heap is left
+		// for things the CPU actually writes
+		requests.push_back({ properties | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+			EXOTIC_MEMORY_FLAGS | (unified ? 0 : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) });
+		// no device local type for this resource (and it wasn't asked for), anything works since it's filled by a copy
+		requests.push_back({ properties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EXOTIC_MEMORY_FLAGS });
+		break;
+	case MemoryUsage::CpuToGpu:
+		// DEVICE_LOCAL | HOST_VISIBLE means the GPU reads it without going over the bus,
+		// worth using even the small BAR heap for that
+		requests.push_back({ properties | hostMask, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EXOTIC_MEMORY_FLAGS });
+		// non-coherent memory works too, JBuffer::write flushes it
+		// (unless coherent was asked for)
+		requests.push_back({ properties | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EXOTIC_MEMORY_FLAGS });
+		break;
+	case MemoryUsage::Staging:
+		// staging only gets copied once, so keep it out of a small BAR heap, a large one is fine
+		requests.push_back({ properties | hostMask, 0,
+			EXOTIC_MEMORY_FLAGS | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+			| (unified || largeBar ? 0 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) });
+		requests.push_back({ properties | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, EXOTIC_MEMORY_FLAGS });
+		break;
+	case MemoryUsage::Readback:
+		// cached memory is much faster for the CPU to read from
+		requests.push_back({ properties | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, EXOTIC_MEMORY_FLAGS });
+		requests.push_back({ properties | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, EXOTIC_MEMORY_FLAGS });
+		break;
+	}
+	// last resort: what was asked for, however exotic
+	// every request has all of properties, they're never dropped
+	requests.push_back({ properties, 0, 0 });
+	return requests;
+}
+
+std::optional<uint32_t> selectMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	const std::vector<MemoryTypeRequest>& requests) {
+	for (const MemoryTypeRequest& request : requests) {
+		std::optional<uint32_t> best;
+		int bestScore = 0;
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+			VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+			if (!(typeFilter & (1 << i)) // check if the ith bit in type filter is 1
+				|| (flags & request.required) != request.required) {
+				// check to make sure it has all of the required properties
+				continue;
+			}
+			int score = countBits(flags & request.preferred) - countBits(flags & request.avoided);
+			// ties go to the lower index, drivers order types by preference
+			if (!best.has_value() || score > bestScore) {
+				best = i;
+				bestScore = score;
+			}
+		}
+		if (best.has_value()) {
+			return best;
 		}
 	}
+	return std::nullopt;
+}
 
-	throw std::runtime_error("no valid memory type found");
+MemoryUsage memoryUsageFor(VkMemoryPropertyFlags properties, VkBufferUsageFlags bufferUsage) {
+	if (!(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+		return MemoryUsage::GpuOnly;
+	}
+	// buffers are often made with more usage bits than they need, so only the ones that matter are looked at
+	const VkBufferUsageFlags gpuRead = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+		| VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
+	if (bufferUsage & gpuRead) {
+		return MemoryUsage::CpuToGpu; // the GPU reads it where it is
+	}
+	if ((bufferUsage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && !(bufferUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) {
+		return MemoryUsage::Readback;
+	}
+	if (bufferUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+		return MemoryUsage::Staging;
+	}
+	return MemoryUsage::CpuToGpu;
+}
+
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	MemoryUsage usage, VkMemoryPropertyFlags properties) {
+	std::optional<uint32_t> type = selectMemoryType(memProperties, typeFilter, memoryTypePolicy(memProperties, usage, properties));
+	if (!type.has_value()) {
+		throw std::runtime_error("no valid memory type found");
+	}
+	return type.value();
+}
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	MemoryUsage usage = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? MemoryUsage::CpuToGpu : MemoryUsage::GpuOnly;
+	return findMemoryType(memProperties, typeFilter, usage, properties);
 }
 
 
@@ -29,31 +156,88 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-	int i = 0;
-	for (const auto& queueFamily : queueFamilies) {
-		// check for graphics support
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			indices.graphicsFamily = i;
+	// look at every family (rather than stopping at the first complete set), the first graphics
+	// family is usually the "main" one, and the dedicated families tend to come later
+	std::optional<uint32_t> computeTransferFamily;
+	for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+		const VkQueueFamilyProperties& queueFamily = queueFamilies[i];
+		if (queueFamily.queueCount == 0) {
+			continue;
 		}
+		bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		// graphics and compute queues can always do transfers, even without the bit
+		bool transfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) || graphics || compute;
+
 		// check for presenting to our window surface support
-		// could add logic to check to see if the queue supports graphics and presentation for efficiency
-		// but it doesn't really matter if they are the same for us
 		VkBool32 presentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-		if (presentSupport) {
+
+		if (graphics && !indices.graphicsFamily.has_value()) {
+			indices.graphicsFamily = i;
+		}
+		// presenting from the graphics family saves an ownership transfer of the swap chain images
+		if (presentSupport && (!indices.presentFamily.has_value() || (graphics && indices.graphicsFamily == i))) {
 			indices.presentFamily = i;
 		}
-
-		if (indices.isComplete()) {
-			break;
+		if (compute && !graphics && !indices.computeFamily.has_value()) {
+			indices.computeFamily = i;
 		}
-
-		++i;
+		if (transfer && !graphics) {
+			if (!compute && !indices.transferFamily.has_value()) {
+				indices.transferFamily = i;
+			}
+			else if (compute && !computeTransferFamily.has_value()) {
+				computeTransferFamily = i;
+			}
+		}
+	}
+	// no DMA queue, a compute queue can still do the copies off the graphics queue
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = computeTransferFamily;
 	}
 
 	return indices;
 }
 
+VkBufferMemoryBarrier bufferOwnershipBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+	uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	if (srcFamily == dstFamily) {
+		srcFamily = dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	}
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	return barrier;
+}
+
+VkImageMemoryBarrier imageOwnershipBarrier(VkImage image, const VkImageSubresourceRange& range,
+	VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	if (srcFamily == dstFamily) {
+		srcFamily = dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	}
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	return barrier;
+}
+
 
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)  {
 	SwapChainSupportDetails details;
@@ -78,3 +262,18 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurface
 	return details;
 }
 
+bool supportsTimelineSemaphores(VkPhysicalDevice device) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return false;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
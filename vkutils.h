@@ -12,6 +12,10 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// families without graphics, only set if the device has them
+	// work on these runs alongside the graphics queue instead of queuing up behind it
+	std::optional<uint32_t> transferFamily; // transfer only (DMA engines), or failing that, compute + transfer
+	std::optional<uint32_t> computeFamily; // async compute
 
 	inline bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -27,8 +31,65 @@ struct SwapChainSupportDetails {
 
 
 
+// how the CPU and GPU access a resource's memory, decides which memory types are preferred
+enum class MemoryUsage {
+	GpuOnly,  // written by transfers, then only read/written by the GPU (vertex buffers, textures)
+	CpuToGpu, // rewritten by the CPU often and read by the GPU (uniforms, per-frame data)
+	Staging,  // written once by the CPU, then copied somewhere else by the GPU
+	Readback  // written by the GPU, read by the CPU
+};
+
+// one step of a memory type policy
+// a type has to have all the required flags, and is scored by how many preferred flags it has
+// and how many avoided flags it doesn't
+struct MemoryTypeRequest {
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	VkMemoryPropertyFlags avoided = 0;
+};
+
+// heaps bigger than this that are both DEVICE_LOCAL and HOST_VISIBLE are resizable BAR (or UMA),
+// smaller ones are the classic 256MB BAR window which is precious
+const constexpr VkDeviceSize SMALL_BAR_HEAP_SIZE = 256 * 1024 * 1024;
+
+// true if every heap is device local, i.e. integrated graphics
+bool isUnifiedMemory(const VkPhysicalDeviceMemoryProperties& memProperties);
+
+// the fallback order for a resource that asked for properties, tried in order
+// every request requires all of properties, only the extra bits a usage prefers are given up
+std::vector<MemoryTypeRequest> memoryTypePolicy(const VkPhysicalDeviceMemoryProperties& memProperties,
+	MemoryUsage usage, VkMemoryPropertyFlags properties);
+
+// best memory type for the first request in the list any type in typeFilter satisfies
+std::optional<uint32_t> selectMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	const std::vector<MemoryTypeRequest>& requests);
+
+// guesses the usage of a buffer from the memory properties and buffer usage flags it was created with
+// host visible buffers the GPU reads directly (uniform, vertex...) are CpuToGpu, otherwise transfer src is
+// Staging and transfer dst alone is Readback
+MemoryUsage memoryUsageFor(VkMemoryPropertyFlags properties, VkBufferUsageFlags bufferUsage);
+
+// selectMemoryType with the default policy for usage, throws if there's no suitable type
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+	MemoryUsage usage, VkMemoryPropertyFlags properties);
+
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 
-SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
\ No newline at end of file
+// queue family ownership transfers for VK_SHARING_MODE_EXCLUSIVE resources
+// record the same barrier twice: on a srcFamily queue to release (dstAccess is ignored there),
+// then on a dstFamily queue to acquire (srcAccess is ignored there), with a semaphore between the submits
+// layout transitions have to be the same in both halves
+// if the families are the same these are just ordinary barriers
+VkBufferMemoryBarrier bufferOwnershipBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+	uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+VkImageMemoryBarrier imageOwnershipBarrier(VkImage image, const VkImageSubresourceRange& range,
+	VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+
+SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+
+// true if the device is Vulkan 1.2 and has the timelineSemaphore feature
+// (the instance has to be 1.1 or newer for vkGetPhysicalDeviceFeatures2)
+bool supportsTimelineSemaphores(VkPhysicalDevice device);
\ No newline at end of file